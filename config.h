@@ -3,3 +3,16 @@
 #define BAUDRATE 9453   /* BAUDRATE */
 #define _9N1 1 /* 8N1 = 0   9N1 = 1 */
 #define _syster /* SYSTER TIMER HACK */
+#define _rxvote /* 3 SAMPLES PER RX BIT, MAJORITY WINS */
+//#define _rxerrsig /* ISO 7816-3 ERROR SIGNAL ON BAD RX FRAMES, DECODER HAS TO REPEAT */
+#define PPS_DI_MAX 2 /* FASTEST ETU OFFERED BY 0x15xx: 1 = BAUDRATE, 2 = x2, 3 = x4 */
+#define RX_TIMEOUT_US 20000 /* INTER-BYTE TIMEOUT, RESYNCS COMMAND DETECTION, < 138ms */
+//#define _deadline /* CONSTANT ECM ANSWER LATENCY, COMMAND 0x32xx */
+#define ECM_DEADLINE_US 80000 /* LAST ECM BYTE TO ANSWER, < 138ms */
+#define _perf /* PERFORMANCE COUNTERS, COMMAND 0x30xx */
+#define _trace /* ISR EVENT TRACE, COMMAND 0x3100 */
+#define TRACE_SIZE 16 /* EVENTS, POWER OF 2 */
+#define _sched /* WATCHDOG AND TASK DEADLINES, ABORTS STALLED COMMANDS */
+#define SCHED_IO_US 100000 /* DECODER SILENT INSIDE A COMMAND, < 138ms */
+#define SCHED_CRYPT_US 100000 /* ECM CRYPTO, LATE IS COUNTED ONLY, < 138ms */
+#define SCHED_EEPROM_US 50000 /* POSTED WRITE-BACK, LATE IS COUNTED ONLY, < 138ms */
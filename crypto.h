@@ -0,0 +1,39 @@
+#ifndef _CRYPTO_H_
+#define _CRYPTO_H_
+
+#include "config.h"
+#include <avr/io.h>
+
+/* Work arena of the crypto engines, defined in main.c. Only one ECM is
+ * decoded at a time, so DES, XTEA and Speck share the space; the DES
+ * call chain keeps its temporaries here instead of stacking them up
+ * under the RX interrupts. Nothing in it survives from one ECM to the next.
+ */
+typedef union
+{
+    struct
+    {
+        uint8_t buffer1[8];         /* _get_syster_cw */
+        uint8_t buffer2[8];
+        uint8_t pcw[8];
+        uint8_t k[8];
+        uint8_t ecw[8];             /* _syster_des_f */
+        uint8_t ek[8];
+        uint8_t r[4];
+        uint8_t T[8];               /* _permute, also used by _syster_key56 */
+    } des;
+    struct
+    {
+        uint32_t s[2];              /* signature, _rand_seed_xtea; the
+                                       block stays in registers */
+    } xtea;
+    struct
+    {
+        uint32_t s[2];              /* signature, _rand_seed_speck */
+        uint32_t l[3];              /* key schedule ring */
+    } speck;
+} crypto_arena_t;
+
+extern crypto_arena_t crypto;
+
+#endif /* _CRYPTO_H_ */
@@ -0,0 +1,92 @@
+#include "config.h"
+#include "eelog.h"
+#include "trace.h"
+
+#include <avr/io.h>
+#include <avr/eeprom.h>
+
+#define EELOG_NONE 0xFF
+
+/* all records empty, phase 0 */
+uint8_t _eelog[EELOG_RECORDS] EEMEM;
+
+static uint8_t eelog_head;
+static uint8_t eelog_phase;                 /* of the record at the head */
+static uint8_t eelog_slot[EELOG_IDS];       /* newest record per setting */
+static uint8_t eelog_value[EELOG_IDS];
+
+static uint8_t _id(uint8_t r)
+{
+    r = (r >> EELOG_ID_SHIFT) & 3;
+    return r < EELOG_IDS ? r : 0;
+}
+
+void eelog_init(void)
+{
+    uint8_t i, r, p0 = eeprom_read_byte(&_eelog[0]) & EELOG_PHASE;
+
+    /* a full pass in one phase: the next one starts over at 0 */
+    eelog_head = 0;
+    eelog_phase = p0 ^ EELOG_PHASE;
+    for(i = 1; i < EELOG_RECORDS; i++){
+        if((eeprom_read_byte(&_eelog[i]) & EELOG_PHASE) != p0){
+            eelog_head = i;
+            eelog_phase = p0;
+            break;
+        }
+    }
+
+    for(i = 0; i < EELOG_IDS; i++)
+        eelog_slot[i] = EELOG_NONE;
+
+    /* oldest to newest, later records win */
+    i = eelog_head;
+    do {
+        r = eeprom_read_byte(&_eelog[i]);
+        if(_id(r)){
+            eelog_slot[_id(r)] = i;
+            eelog_value[_id(r)] = r & EELOG_VALUE;
+        }
+        if(++i == EELOG_RECORDS)
+            i = 0;
+    } while(i != eelog_head);
+}
+
+uint8_t eelog_get(uint8_t id, uint8_t dflt)
+{
+    return eelog_slot[id] == EELOG_NONE ? dflt : eelog_value[id];
+}
+
+static void _append(uint8_t id, uint8_t value)
+{
+    uint8_t h = eelog_head;
+
+    TRACE(TRACE_EEPROM, (uint16_t) &_eelog[h]);
+    eeprom_write_byte(&_eelog[h], eelog_phase | (id << EELOG_ID_SHIFT) | value);
+    eelog_slot[id] = h;
+    eelog_value[id] = value;
+
+    if(++h == EELOG_RECORDS){
+        h = 0;
+        eelog_phase ^= EELOG_PHASE;
+    }
+    eelog_head = h;
+}
+
+void eelog_put(uint8_t id, uint8_t value)
+{
+    uint8_t w;
+
+    value &= EELOG_VALUE;
+    if(eelog_slot[id] != EELOG_NONE && eelog_value[id] == value)
+        return;
+
+    /* the head may hold the only copy of another setting, carry it on */
+    for(w = 1; w < EELOG_IDS; w++){
+        if(w != id && eelog_slot[w] == eelog_head){
+            _append(w, eelog_value[w]);
+            w = 0;
+        }
+    }
+    _append(id, value);
+}
@@ -0,0 +1,36 @@
+#ifndef _EELOG_H_
+#define _EELOG_H_
+
+#include "config.h"
+#include <avr/io.h>
+
+/* Append-only EEPROM log for the settings switched all the time, crypt
+ * mode (0x04xx) and ATR index (0x14xx). A record is one byte:
+ *
+ *   bit 7    phase, flips with every pass over the ring
+ *   bit 6..5 setting id, 0 and 3 = empty
+ *   bit 4..0 value
+ *
+ * so an update is a single EEPROM byte written at the head of the ring,
+ * never in place, and the writes are spread over EELOG_RECORDS cells.
+ * The head is where the phase changes. eelog_init() finds it at boot and
+ * indexes the newest record of each setting, after that reads come from
+ * RAM. The log isn't part of the image CRC, 0x04xx/0x14xx don't reseal.
+ */
+#define EELOG_RECORDS  64
+
+#define EELOG_PHASE    0x80
+#define EELOG_ID_SHIFT 5
+#define EELOG_VALUE    0x1F
+
+#define EELOG_CRYPTMODE 1
+#define EELOG_ATRINDEX  2
+#define EELOG_IDS       3
+
+extern uint8_t _eelog[EELOG_RECORDS];
+
+extern void eelog_init(void);
+extern uint8_t eelog_get(uint8_t id, uint8_t dflt);
+extern void eelog_put(uint8_t id, uint8_t value);
+
+#endif /* _EELOG_H_ */
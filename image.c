@@ -0,0 +1,145 @@
+#include "config.h"
+#include "image.h"
+#include "keystore.h"
+#include "profile.h"
+#include "uart.h"
+#include "trace.h"
+
+#include <avr/io.h>
+#include <avr/pgmspace.h>
+#include <avr/eeprom.h>
+#include <util/crc16.h>
+
+/* EEPROM VALUES, see main.c */
+extern uint8_t _cryptmode;
+extern uint8_t _atrindex;
+extern uint8_t _response_0201[];
+extern uint8_t _response_5F000000[];
+extern uint8_t _response_5F000100[];
+extern uint32_t _xtea_key[2][4];
+
+uint8_t _image_state EEMEM = IMAGE_NEW;
+uint16_t _image_crc EEMEM = 0;
+
+const image_region_t _image_region[] PROGMEM = {
+    {(uint8_t *) _keyslot, sizeof(keyslot_t) * KEYSLOTS},
+    {(uint8_t *) _xtea_key, 32},
+    {&_response_0201[2], 8},
+    {_response_5F000000, 10},
+    {_response_5F000100, 10},
+    {&_cryptmode, 1},
+    {&_atrindex, 1},
+};
+
+#define IMAGE_REGIONS (sizeof(_image_region) / sizeof(image_region_t))
+
+uint16_t image_size(void)
+{
+    uint16_t n = 0;
+    uint8_t r;
+
+    for(r = 0; r < IMAGE_REGIONS; r++)
+        n += pgm_read_word(&_image_region[r].len);
+    return n;
+}
+
+/* Receive a complete image, one 0x101 per pair. The pair carrying the
+ * last CRC byte is answered by the caller. Returns 0 if the CRC matched.
+ */
+uint8_t image_receive(void)
+{
+    uint8_t blk[IMAGE_BLOCK], fill = 0, r = 0, i, c;
+    uint8_t *dst = (uint8_t *) pgm_read_word(&_image_region[0].addr);
+    uint16_t left = pgm_read_word(&_image_region[0].len);
+    uint16_t pos = 0, size = image_size(), crc = 0xFFFF, rx = 0;
+
+    TRACE(TRACE_EEPROM, (uint16_t) &_image_state);
+    eeprom_update_byte(&_image_state, IMAGE_DIRTY);
+
+    /* size is even, the CRC always fills the last pair */
+    while(pos < size + 2){
+        for(i = 0; i < 2; i++, pos++){
+            c = io_read() & 0xFF;
+            if(pos >= size){
+                rx |= (uint16_t) c << ((pos - size) * 8);
+                continue;
+            }
+            crc = _crc_ccitt_update(crc, c);
+            blk[fill++] = c;
+            left--;
+            if(fill == IMAGE_BLOCK || left == 0){
+                eeprom_update_block(blk, dst, fill);
+                dst += fill;
+                fill = 0;
+            }
+            if(left == 0 && ++r < IMAGE_REGIONS){
+                dst = (uint8_t *) pgm_read_word(&_image_region[r].addr);
+                left = pgm_read_word(&_image_region[r].len);
+            }
+        }
+        if(pos < size + 2)
+            io_write(0x101);
+    }
+
+    if(rx != crc)
+        return 1;
+    eeprom_update_byte(&_image_state, IMAGE_OK);
+    image_seal();
+    return 0;
+}
+
+static uint16_t _crc_block(uint16_t crc, const uint8_t *addr, uint16_t len)
+{
+    while(len--)
+        crc = _crc_ccitt_update(crc, eeprom_read_byte(addr++));
+    return crc;
+}
+
+/* CRC over everything the card runs from: the image and the profiles */
+uint16_t image_crc(void)
+{
+    uint16_t crc = 0xFFFF;
+    uint8_t r;
+
+    for(r = 0; r < IMAGE_REGIONS; r++)
+        crc = _crc_block(crc, (const uint8_t *) pgm_read_word(&_image_region[r].addr),
+                         pgm_read_word(&_image_region[r].len));
+    return _crc_block(crc, (const uint8_t *) _profile, sizeof(_profile));
+}
+
+/* A legitimate write is in, the seal follows later */
+void image_stale(void)
+{
+    if(eeprom_read_byte(&_image_state) != IMAGE_OK)
+        return;
+    TRACE(TRACE_EEPROM, (uint16_t) &_image_state);
+    eeprom_update_byte(&_image_state, IMAGE_STALE);
+}
+
+/* After a legitimate write, a dirty or corrupt image keeps its state */
+void image_seal(void)
+{
+    uint8_t state = eeprom_read_byte(&_image_state);
+
+    if(state != IMAGE_OK && state != IMAGE_STALE)
+        return;
+    TRACE(TRACE_EEPROM, (uint16_t) &_image_crc);
+    eeprom_update_word(&_image_crc, image_crc());
+    eeprom_update_byte(&_image_state, IMAGE_OK);
+}
+
+uint8_t image_check(void)
+{
+    uint8_t state = eeprom_read_byte(&_image_state);
+
+    if(state == IMAGE_NEW || state == IMAGE_STALE){
+        eeprom_update_byte(&_image_state, IMAGE_OK);
+        image_seal();
+        return IMAGE_OK;
+    }
+    if(state == IMAGE_OK && eeprom_read_word(&_image_crc) != image_crc()){
+        eeprom_update_byte(&_image_state, IMAGE_CORRUPT);
+        return IMAGE_CORRUPT;
+    }
+    return state;
+}
@@ -0,0 +1,43 @@
+#ifndef _IMAGE_H_
+#define _IMAGE_H_
+
+#include "config.h"
+#include <avr/io.h>
+
+/* Bulk provisioning, command 0x2600. The decoder streams IMAGE_SIZE
+ * bytes in the order of _image_region[] followed by a CRC-16 over them
+ * (avr-libc _crc_ccitt_update, start 0xFFFF, low byte first). Data is
+ * written block by block while it arrives, _image_state stays
+ * IMAGE_DIRTY until a transfer with a good CRC has completed.
+ */
+#define IMAGE_BLOCK 16
+
+/* At boot image_check() verifies the CRC over the image regions and
+ * the operator profiles against _image_crc. A freshly flashed card
+ * (IMAGE_NEW) is sealed then, later writes reseal with image_seal().
+ * A write whose seal is deferred marks the image IMAGE_STALE first, so
+ * losing power before the seal doesn't read as corruption.
+ */
+#define IMAGE_OK      0x00
+#define IMAGE_NEW     0xA5          /* as flashed, not sealed yet */
+#define IMAGE_STALE   0x5A          /* written, seal still posted */
+#define IMAGE_CORRUPT 0xC0          /* CRC mismatch at boot */
+#define IMAGE_DIRTY   0xFF
+
+typedef struct
+{
+    uint8_t *addr;                  /* EEPROM */
+    uint16_t len;
+} image_region_t;
+
+extern uint8_t _image_state;
+extern uint16_t _image_crc;
+
+extern uint16_t image_size(void);
+extern uint8_t image_receive(void);
+extern uint16_t image_crc(void);
+extern void image_stale(void);
+extern void image_seal(void);
+extern uint8_t image_check(void);
+
+#endif /* _IMAGE_H_ */
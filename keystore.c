@@ -0,0 +1,103 @@
+#include "config.h"
+#include "keystore.h"
+#include "trace.h"
+
+#include <avr/io.h>
+#include <avr/eeprom.h>
+#include <string.h>
+
+keyslot_t _keyslot[KEYSLOTS] EEMEM = {
+    {0, 0, 0, 0, {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x12, 0x34}}, // Key 0 premiere
+    {0, 1, 0, 0, {0x00, 0xE2, 0x51, 0x6D, 0x15, 0x97, 0x51, 0x55}}, // Key 1 premiere
+    {1, 0, 0, 0, {0x00, 0xAE, 0x52, 0x90, 0x49, 0xF1, 0xF1, 0xBB}}, // KEY 0 C+ France
+    {1, 1, 0, 0, {0x00, 0xE9, 0xEB, 0xB3, 0xA6, 0xDB, 0x3C, 0x87}}, // KEY 1 C+ France
+    {2, 0, 0, 0, {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}}, // Key 0 C+ Poland
+    {2, 1, 0, 0, {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}}, // Key 1 C+ Poland
+    {3, 0, 0, 0, {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}}, // Key 0 reserved
+    {3, 1, 0, 0, {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}}, // Key 1 reserved
+    {KEY_OP_ANY, KEY_AUD11, 0, 0, {0xC4, 0xA5, 0xA8, 0x18, 0x74, 0x93, 0xC7, 0x65}}, // audience 0x11
+    {KEY_OP_FREE}, {KEY_OP_FREE}, {KEY_OP_FREE}, {KEY_OP_FREE},
+    {KEY_OP_FREE}, {KEY_OP_FREE}, {KEY_OP_FREE},
+};
+
+uint8_t keystore_index[PROFILES][KEY_INDEXES];
+
+/* earliest valid_from still in the future, 0xFFFF = none */
+static uint16_t keystore_next;
+static uint16_t keystore_today;
+
+void keystore_build(uint16_t date)
+{
+    uint8_t s, op, idx, best, ver[PROFILES][KEY_INDEXES];
+    keyslot_t m;
+
+    memset(keystore_index, KEY_NONE, sizeof(keystore_index));
+    keystore_today = date;
+    keystore_next = 0xFFFF;
+
+    for(s = 0; s < KEYSLOTS; s++){
+        eeprom_read_block(&m, &_keyslot[s], KEYSLOT_META);
+        if(m.op == KEY_OP_FREE || m.index >= KEY_INDEXES)
+            continue;
+        if(m.valid_from > date){
+            if(m.valid_from < keystore_next)
+                keystore_next = m.valid_from;
+            continue;
+        }
+        idx = m.index;
+        for(op = 0; op < PROFILES; op++){
+            if(m.op != op && m.op != KEY_OP_ANY)
+                continue;
+            best = keystore_index[op][idx];
+            if(best != KEY_NONE){
+                /* operator slot beats KEY_OP_ANY, then newest version */
+                uint8_t best_any = eeprom_read_byte(&_keyslot[best].op) == KEY_OP_ANY;
+                uint8_t any = m.op == KEY_OP_ANY;
+                if(any > best_any || (any == best_any && m.version <= ver[op][idx]))
+                    continue;
+            }
+            keystore_index[op][idx] = s;
+            ver[op][idx] = m.version;
+        }
+    }
+}
+
+/* Advance the card's idea of today, returns 1 when a pending key has
+ * become valid and the index was rebuilt.
+ */
+uint8_t keystore_date(uint16_t date)
+{
+    if(date <= keystore_today)
+        return 0;
+    keystore_today = date;
+    if(date < keystore_next)
+        return 0;
+    keystore_build(date);
+    return 1;
+}
+
+uint8_t keystore_key(uint8_t op, uint8_t index, uint8_t *k64)
+{
+    uint8_t s = keystore_index[op][index];
+
+    if(s == KEY_NONE){
+        memset(k64, 0, 8);
+        return 0;
+    }
+    eeprom_read_block(k64, _keyslot[s].key, 8);
+    return 1;
+}
+
+void keystore_write_key(uint8_t slot, const uint8_t *key)
+{
+    TRACE(TRACE_EEPROM, (uint16_t) _keyslot[slot].key);
+    eeprom_update_block(key, _keyslot[slot].key, 8);
+    keystore_build(keystore_today);
+}
+
+void keystore_write_meta(uint8_t slot, const uint8_t *meta)
+{
+    TRACE(TRACE_EEPROM, (uint16_t) &_keyslot[slot]);
+    eeprom_update_block(meta, &_keyslot[slot], KEYSLOT_META);
+    keystore_build(keystore_today);
+}
@@ -0,0 +1,49 @@
+#ifndef _KEYSTORE_H_
+#define _KEYSTORE_H_
+
+#include "config.h"
+#include "profile.h"
+#include <avr/io.h>
+
+/* DES key slots in EEPROM. Each slot is tagged with the operator
+ * (profile) and key index it serves, a version and the date it becomes
+ * valid. keystore_index[][] names the slot in use for every operator
+ * and key index: the highest version already valid, a slot for the
+ * operator itself beats a KEY_OP_ANY slot.
+ *
+ * The lookup is constant time, but there is no precomputed DES schedule
+ * behind it. profile_select() keeps only the 56-bit key of each index;
+ * _get_syster_cw() still derives the round subkeys per ECM by rotation.
+ * Sixteen 7-byte subkeys for each of three keys would take 336 of the
+ * 512 bytes of SRAM.
+ */
+#define KEYSLOTS 16
+
+#define KEY_INDEXES 3               /* ECM key 0, key 1, audience 0x11 */
+#define KEY_AUD11   2
+
+#define KEY_OP_ANY  0x0F            /* serves every operator */
+#define KEY_OP_FREE 0xFF            /* empty slot */
+#define KEY_NONE    0xFF
+
+typedef struct
+{
+    uint8_t op;
+    uint8_t index;
+    uint8_t version;
+    uint16_t valid_from;            /* Syster date, like _mindate */
+    uint8_t key[8];
+} keyslot_t;
+
+#define KEYSLOT_META 5              /* op, index, version, valid_from */
+
+extern keyslot_t _keyslot[KEYSLOTS];
+extern uint8_t keystore_index[PROFILES][KEY_INDEXES];
+
+extern void keystore_build(uint16_t date);
+extern uint8_t keystore_date(uint16_t date);
+extern uint8_t keystore_key(uint8_t op, uint8_t index, uint8_t *k64);
+extern void keystore_write_key(uint8_t slot, const uint8_t *key);
+extern void keystore_write_meta(uint8_t slot, const uint8_t *meta);
+
+#endif /* _KEYSTORE_H_ */
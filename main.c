@@ -34,9 +34,19 @@
 #include <string.h>
 #include <avr/eeprom.h>
 #include "systerdes.h"
+#include "perf.h"
+#include "trace.h"
+#include "tick.h"
+#include "profile.h"
+#include "keystore.h"
+#include "image.h"
+#include "crypto.h"
+#include "sched.h"
+#include "eelog.h"
 
 /* Some helpers */
 uint8_t check = 0;
+/* as provisioned, 0x04xx/0x14xx go to the log, see eelog.h */
 uint8_t _cryptmode EEMEM = 0;
 uint8_t _atrindex EEMEM = 0x10;
 uint16_t _maxdate = 0;
@@ -44,18 +54,7 @@ uint16_t _mindate = 0;
 
 
 /* PROGMEM VALUES */
-const uint8_t _response_0200_prde[] PROGMEM = {
-	0xA0,0x02,0x1C,0x38,0x14,0x05,0xFF,0x14,0xE1,0xE5,0x00
-};
-
-const uint8_t _response_0200_cpfr[] PROGMEM = {
-	0xA0,0x02,0x18,0x38,0x12,0x00,0xFF,0x14,0x80,0x83,0x00
-};
-
-const uint8_t _response_0200_cppl[] PROGMEM = {
-	0xA0,0x02,0x1C,0xE0,0x0C,0x01,0xFF,0x14,0xE1,0xE5,0x00
-};
-
+/* 0x0200 answers live in the operator profiles, see profile.c */
 const uint8_t _response_5700[] PROGMEM = {
 	0x01,0x02,0x4F,0x53,0x30,0x40,0x74,0x72,0x4B,0x1D,0x00
 };
@@ -90,42 +89,76 @@ uint32_t _xtea_key[2][4] EEMEM = {
     {0xd5784071,0x48909110,0x01260c7a,0xd5579e9d},
 };
 
-uint8_t _deskey[8][8] EEMEM = {
-    {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x12, 0x34}, // Key 0 premiere
-    {0x00, 0xE2, 0x51, 0x6D, 0x15, 0x97, 0x51, 0x55}, // Key 1 premiere
-    {0x00, 0xAE, 0x52, 0x90, 0x49, 0xF1, 0xF1, 0xBB}, // KEY 0 C+ France
-    {0x00, 0xE9, 0xEB, 0xB3, 0xA6, 0xDB, 0x3C, 0x87}, // KEY 1 C+ France
-    {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // Key 0 C+ Poland
-    {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // Key 1 C+ Poland
-    {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // Key 0 reserved
-    {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // Key 1 reserved
-};
+/* DES keys live in the key store, see keystore.c */
 
-uint8_t _des11key[] EEMEM = {
-    0xC4, 0xA5, 0xA8, 0x18, 0x74, 0x93, 0xC7, 0x65
+/* ECM key index by command nibble: 0x060N, 0x061N, 0x062N */
+const uint8_t _ecm_keyindex[4] PROGMEM = {
+    0, KEY_AUD11, 1, 0
 };
 
-/* Response buffer */
-static uint16_t _ob[16];
-static int _ob_x = 0;
-static int _ob_len = 0;
+/* Payload buffer, command input */
+static uint8_t _ib[16];
+
+/* Output slots, CW and DES audience byte. Engines fill the back slot
+ * while the front one may still be polled, _publish() hands the back
+ * slot out and swaps.
+ */
+static uint8_t _out[2][9];
+static uint8_t _back;
+
+#ifdef _deadline
+/* Constant ECM latency: the answer is held until the deadline after the
+ * last ECM byte, polls get 0x101 until then. Slack is the time left
+ * when the engine finished, in ticks; read with 0x3200.
+ */
+static tick_timer_t _ecm_deadline;
+static uint16_t _held;          /* head of the held answer, 0 = none */
+
+static struct {
+    uint16_t deadline;
+    uint16_t last;
+    uint16_t min;
+    uint16_t missed;
+} _slack = { TICKS_US(ECM_DEADLINE_US), 0, 0xFFFF, 0 };
+#endif // _deadline
+
+/* Crypto work arena, see crypto.h */
+crypto_arena_t crypto;
+
+/* Pending response, handed out one frame per FF FF poll. head and tail
+ * are sent with the 9th bit set around len body bytes, which are read
+ * from RAM, flash or EEPROM only when the decoder polls for them.
+ */
+#define RSP_RAM 0
+#define RSP_PGM 1
+#define RSP_EE  2
+
+typedef struct {
+    uint16_t head;          /* 0 = none */
+    uint16_t tail;          /* 0 = none */
+    const uint8_t *addr;
+    uint8_t len;
+    uint8_t src;
+} response_t;
+
+static response_t _rsp;
 static uint8_t cryptmode;
 static uint8_t keyindex;
 static uint8_t atrindex;
-static uint8_t key64[8];
 
 void _update_channels(void){
-    int i;
-    for(i=0;i<8;i++){
-        eeprom_update_byte(&_response_0201[i+2],(_ob[i]&0xff));
-    }
+    TRACE(TRACE_EEPROM, (uint16_t) &_response_0201[2]);
+    eeprom_update_block(_ib,&_response_0201[2],8);
 }
 
-void _update_key(uint8_t ki){
-    int i;
-    for(i=0;i<8;i++){
-        eeprom_update_byte(&_deskey[ki][i],(_ob[i]&0xff));
-    }
+/* (Re)load everything derived from EEPROM settings */
+void _load_settings(void){
+    cryptmode = eelog_get(EELOG_CRYPTMODE,eeprom_read_byte(&_cryptmode));
+    atrindex = eelog_get(EELOG_ATRINDEX,eeprom_read_byte(&_atrindex));
+    eeprom_read_block(&_mindate,&_response_5F000000[8],2);
+    eeprom_read_block(&_maxdate,&_response_5F000100[6],2);
+    keystore_build(_mindate);
+    profile_select(atrindex,cryptmode);
 }
 
 void _rand_seed_des(uint8_t ki,uint8_t aud){
@@ -133,21 +166,14 @@ void _rand_seed_des(uint8_t ki,uint8_t aud){
     enable_rx(); /* Answer FF FF during decryption */
     uint16_t checkdate = 0;
 
-    if(aud == 0x11){
-        eeprom_read_block(key64,_des11key,8);
-    } else {
-        eeprom_read_block(key64,_deskey[ki+((atrindex & 0xf) * 2)],8);
-    }
-
-
-    uint8_t ib[16],i;
-    uint8_t ob[9];
-    for(i=0;i<16;i++)ib[i] = _ob[i];
-    checkdate = _get_syster_cw(ib,key64,ob);
-    for(i=0;i<8;i++)_ob[i+1] = ob[i];
-    if((atrindex & 0xF0) == 0x10 && aud != 0x11){
+    uint8_t *ob = _out[_back];
+    checkdate = _get_syster_cw(_ib,profile.key.des[ki],ob);
+    if(profile.datecheck && aud != 0x11){
         if(checkdate >= _mindate && checkdate <= _maxdate && aud == ob[8] ){
             check = 0;
+            /* a key slot may have become valid */
+            if(keystore_date(checkdate))
+                profile_select(atrindex,cryptmode);
         } else {
             check = 1;
         };
@@ -159,27 +185,24 @@ void _rand_seed_xtea(uint8_t ki)
 {
 	int i;
 	uint32_t v0 = 0;
-	uint32_t s0 = 0;
 	uint32_t v1 = 0;
-	uint32_t s1 = 0;
+	uint32_t *s = crypto.xtea.s;
+	uint8_t *ob = _out[_back];
 	uint32_t sum = 0;
 	uint32_t delta = 0x9E3779B9;
 
-    uint32_t xtea_key[4];
-    for(i=0;i<4;i++){
-        xtea_key[i] = eeprom_read_dword(&_xtea_key[ki % 2][i]);
-    }
+    uint32_t *xtea_key = profile.key.xtea[ki % 2];
      for(i=3;i>-1;i--){
         v1 <<= 8;
-        v1 |= (_ob[i] & 0xff);
-        s1 <<= 8;
-        s1 |= (_ob[i+8] & 0xff);
+        v1 |= (_ib[i] & 0xff);
+        s[1] <<= 8;
+        s[1] |= (_ib[i+8] & 0xff);
         v0 <<= 8;
-        v0 |= (_ob[i+4] &0xff); //8 12
-        s0 <<= 8;
-        s0 |= (_ob[i+12] & 0xff);
+        v0 |= (_ib[i+4] &0xff); //8 12
+        s[0] <<= 8;
+        s[0] |= (_ib[i+12] & 0xff);
     }
-if(cryptmode == 2){
+if(profile.cryptmode == 2){
 	for (i = 0; i < 32;i++)
 	{
 		v0 += (((v1 << 4)^(v1 >> 5)) + v1)^(sum + xtea_key[sum & 3]);
@@ -188,7 +211,7 @@ if(cryptmode == 2){
 		if(i == 7)
 		{
             /* SIG-CHECK */
-            if((v0 == s0) && (v1 == s1)){
+            if((v0 == s[0]) && (v1 == s[1])){
                 check = 0;
             }else{
                 check = 1;
@@ -198,37 +221,168 @@ if(cryptmode == 2){
 	}
 }
     for(i=0;i<4;i++){
-        _ob[i+1] = 0 | ((v1>>(i*8)) & 0xFF);
-        _ob[i+5] = 0 | ((v0>>(i*8)) & 0xFF);
+        ob[i+0] = 0 | ((v1>>(i*8)) & 0xFF);
+        ob[i+4] = 0 | ((v0>>(i*8)) & 0xFF);
     }
 }
 
+/* Speck64/128 on the XTEA keys, framed like XTEA: the block in bytes
+ * 0..7, the state after round 8 as signature in bytes 8..15, all words
+ * little endian, y first. Rotating by 8 is a byte move on the AVR, the
+ * key schedule runs alongside the rounds. Encoder: tools/speckenc.c
+ */
+#define SPECK_ROUNDS 27
+#define SPECK_ROR8(x) (((x) >> 8) | ((x) << 24))
+#define SPECK_ROL3(x) (((x) << 3) | ((x) >> 29))
 
+void _rand_seed_speck(uint8_t ki)
+{
+    uint8_t i, j = 0;
+    uint32_t x, y, k;
+    uint32_t *l = crypto.speck.l;
+    uint32_t *s = crypto.speck.s;
+    uint8_t *ob = _out[_back];
+
+    k = profile.key.xtea[ki % 2][0];
+    memcpy(l, &profile.key.xtea[ki % 2][1], sizeof(crypto.speck.l));
+    memcpy(&y, &_ib[0], 4);
+    memcpy(&x, &_ib[4], 4);
+    memcpy(s, &_ib[8], 8);
+
+    for(i = 0; i < SPECK_ROUNDS; i++){
+        x = (SPECK_ROR8(x) + y) ^ k;
+        y = SPECK_ROL3(y) ^ x;
+        if(i == 7){
+            /* SIG-CHECK */
+            check = (y != s[0]) || (x != s[1]);
+            if(check)
+                break;
+        }
+        l[j] = (k + SPECK_ROR8(l[j])) ^ i;
+        k = SPECK_ROL3(k) ^ l[j];
+        if(++j == 3)
+            j = 0;
+    }
 
-void _io_response_ee(const uint8_t *data)
+    memcpy(&ob[0], &y, 4);
+    memcpy(&ob[4], &x, 4);
+}
+
+
+
+void _respond(uint8_t src, const uint8_t *addr, uint8_t len, uint16_t head, uint16_t tail)
 {
-	int i;
-	for(i = 1; i < 11; i++)
+	/* io_busy_answer() may read it from the RX interrupt */
+	uint8_t sreg = SREG;
+	cli();
+	_rsp.src = src;
+	_rsp.addr = addr;
+	_rsp.len = len;
+	_rsp.head = head;
+	_rsp.tail = tail;
+	SREG = sreg;
+}
+
+/* Hand out the back output slot, the next command fills the other one */
+void _publish(uint16_t head, uint16_t tail)
+{
+	_respond(RSP_RAM, _out[_back], 8, head, tail);
+	_back ^= 1;
+}
+
+uint16_t _response_next(void)
+{
+	uint16_t c = 0x101;
+
+	if(_rsp.head)
+	{
+		c = _rsp.head;
+		_rsp.head = 0;
+	}
+	else if(_rsp.len)
+	{
+		switch(_rsp.src){
+			case RSP_RAM: c = *_rsp.addr; break;
+			case RSP_PGM: c = pgm_read_byte(_rsp.addr); break;
+			case RSP_EE:  c = eeprom_read_byte(_rsp.addr); break;
+		}
+		_rsp.addr++;
+		_rsp.len--;
+	}
+	else if(_rsp.tail)
+	{
+		c = _rsp.tail;
+		_rsp.tail = 0;
+	}
+	return c;
+}
+
+/* A new ECM drops a response whose head the decoder hasn't fetched yet,
+ * so the polls for the new one can't take the old 0x106 and CW for theirs.
+ */
+void _response_drop_unread(void)
+{
+	uint8_t sreg = SREG;
+	cli();
+	if(_rsp.head)
 	{
-		_ob[(_ob_x + _ob_len) & 0x0F] = eeprom_read_byte(&data[i]);
-		_ob_len++;
+		_rsp.head = 0;
+		_rsp.len = 0;
+		_rsp.tail = 0;
 	}
-	_ob[_ob_x] |= 0x100;
-	_ob[(_ob_x + 9) & 0x0F] |= 0x100;
+	SREG = sreg;
+}
+
+/* Called from the RX interrupt (uart.c, _syster) for a pair the main
+ * loop is too busy to take, e.g. during an ECM. FF FF gets the rest of
+ * a RAM response the decoder has already started on, the previous CW
+ * from the front slot; anything else is 0x101 until the main loop is
+ * back. EEPROM and flash responses aren't safe to read here.
+ */
+uint16_t io_busy_answer(uint16_t a, uint16_t b)
+{
+	if(a == 0x1FF && b == 0x0FF && _rsp.src == RSP_RAM && !_rsp.head)
+		return _response_next();
+	return 0x101;
+}
+
+void _ecm_publish(uint16_t head)
+{
+    if(head == 0x106)
+        _publish(0x106, 0x102);
+    else
+        _respond(RSP_RAM, 0, 0, 0x10A, 0);
+}
+
+void _ecm_answer(uint16_t head)
+{
+#ifdef _deadline
+    tick_t used = tick_now() - _ecm_deadline.start;
+
+    if(used >= _ecm_deadline.len){
+        _slack.last = 0;
+        _slack.missed++;
+    } else {
+        _slack.last = _ecm_deadline.len - used;
+        if(_slack.last < _slack.min) _slack.min = _slack.last;
+    }
+    _held = head;
+#else
+    _ecm_publish(head);
+#endif // _deadline
+}
+
+/* 11 byte tables: answer, 0x1xx, 8 bytes, 0x1xx */
+void _io_response_ee(const uint8_t *data)
+{
+	_respond(RSP_EE, &data[2], 8, 0x100 | eeprom_read_byte(&data[1]), 0x100 | eeprom_read_byte(&data[10]));
 
 	io_write(0x100 | eeprom_read_byte(&data[0]));
 }
 
 void _io_response_pgm(const uint8_t *data)
 {
-	int i;
-	for(i = 1; i < 11; i++)
-	{
-		_ob[(_ob_x + _ob_len) & 0x0F] = pgm_read_byte(&data[i]);
-		_ob_len++;
-	}
-	_ob[_ob_x] |= 0x100;
-	_ob[(_ob_x + 9) & 0x0F] |= 0x100;
+	_respond(RSP_PGM, &data[2], 8, 0x100 | pgm_read_byte(&data[1]), 0x100 | pgm_read_byte(&data[10]));
 
 	io_write(0x100 | pgm_read_byte(&data[0]));
 }
@@ -237,6 +391,20 @@ void _command(uint16_t cmd)
 {
 	uint16_t c;
 	int i;
+#ifdef _perf
+	uint32_t t;
+
+	perf_command(cmd);
+#endif // _perf
+	TRACE(TRACE_CMD, cmd >> 8);
+
+#ifdef _deadline
+	/* any other command releases a held answer, it owns the back slot */
+	if(_held && cmd != 0xFFFF){
+		_ecm_publish(_held);
+		_held = 0;
+	}
+#endif // _deadline
 
 	switch(cmd)
 	{
@@ -246,43 +414,53 @@ void _command(uint16_t cmd)
 
                 for(i = 0; i < 8; i += 2)
                 {
-                    _ob[i + 0] = io_read();
-                    _ob[i + 1] = io_read();
+                    _ib[i + 0] = io_read();
+                    _ib[i + 1] = io_read();
                     io_write(0x101);
                 }
+                image_stale();
                 _update_channels();
+                sched_post(SCHED_EEPROM);
                 io_read();
                 io_read();
                 io_write(0x100);
 
                 break;
-	case 0x0200:
-                switch(atrindex & 0x0F){
-                    case 0x00:
-                        _io_response_pgm(_response_0200_prde); break;
-                    case 0x01:
-                        _io_response_pgm(_response_0200_cpfr); break;
-                    case 0x02:
-                        _io_response_pgm(_response_0200_cppl); break;
-                } break;
+	case 0x0200: _io_response_ee(profile.response_0200); break;
 	case 0x0201: _io_response_ee(_response_0201); break;
 	case 0x0400:
     case 0x0401:
     case 0x0402:
+    case 0x0403:
                 io_write(0x1FF);
 
                 cryptmode = cmd & 0xFF;
-                eeprom_update_byte(&_cryptmode,cryptmode); break;
+                eelog_put(EELOG_CRYPTMODE,cryptmode);
+                profile_select(atrindex,cryptmode); break;
 	case 0x1400:
     case 0x1401:
     case 0x1402:
+    case 0x1403:
 	case 0x1410:
     case 0x1411:
     case 0x1412:
+    case 0x1413:
                 io_write(0x1FF);
 
                 atrindex = cmd & 0xFF;
-                eeprom_update_byte(&_atrindex,atrindex); break;
+                eelog_put(EELOG_ATRINDEX,atrindex);
+                profile_select(atrindex,cryptmode); break;
+    case 0x1500:
+                io_write(0x100 | PPS_TA1); break;
+    case 0x1511:
+    case 0x1512:
+    case 0x1513:
+    case 0x1514:
+                /* PPS1 is echoed on success, anything else means default */
+                c = cmd & 0xFF;
+                if((c & 0x0F) > PPS_DI_MAX) c = 0x11;
+                io_write(0x100 | c);
+                io_set_etu(IO_ETU_DEFAULT >> ((c & 0x0F) - 1)); break;
     case 0x2400:
     case 0x2401:
     case 0x2402:
@@ -303,12 +481,58 @@ void _command(uint16_t cmd)
 
                 keyindex = cmd & 0x0F;
                 		for(i = 0; i < 8; i += 2){
-                            _ob[i + 0] = io_read();
-                            _ob[i + 1] = io_read();
+                            _ib[i + 0] = io_read();
+                            _ib[i + 1] = io_read();
+                            io_write(0x124);
+
+                        }
+                image_stale();
+                keystore_write_key(keyindex,_ib);
+                sched_post(SCHED_EEPROM);
+                profile_select(atrindex,cryptmode); break;
+    case 0x2500:
+    case 0x2501:
+    case 0x2502:
+    case 0x2503:
+    case 0x2504:
+    case 0x2505:
+    case 0x2506:
+    case 0x2507:
+    case 0x2508:
+    case 0x2509:
+    case 0x250A:
+    case 0x250B:
+    case 0x250C:
+    case 0x250D:
+    case 0x250E:
+    case 0x250F:
+                io_write(0x1FF);
+
+                keyindex = cmd & 0x0F;
+                		for(i = 0; i < KEYSLOT_META + 1; i += 2){
+                            _ib[i + 0] = io_read();
+                            _ib[i + 1] = io_read();
                             io_write(0x124);
 
                         }
-                _update_key(keyindex);break;
+                image_stale();
+                keystore_write_meta(keyindex,_ib);
+                sched_post(SCHED_EEPROM);
+                profile_select(atrindex,cryptmode); break;
+    case 0x2600:
+                io_write(0x1FF);
+
+                c = image_receive();
+                if(c == 0){
+                    /* the image's settings win over the logged ones */
+                    eelog_put(EELOG_CRYPTMODE,eeprom_read_byte(&_cryptmode));
+                    eelog_put(EELOG_ATRINDEX,eeprom_read_byte(&_atrindex));
+                }
+                _load_settings();
+                io_write(c ? 0x10A : 0x100); break;
+    case 0x2601:
+                c = eeprom_read_byte(&_image_state);
+                io_write(c == IMAGE_OK || c == IMAGE_STALE ? 0x100 : 0x10A); break;
 	case 0x5700: _io_response_pgm(_response_5700); break;
 	case 0x5701: _io_response_pgm(_response_5701); break;
 	case 0x5702: _io_response_pgm(_response_5702); break;
@@ -321,30 +545,13 @@ void _command(uint16_t cmd)
                     case 0x00:
                         io_write(0x101);
 
-                        _ob_x = 0;
-                        _ob_len = 0;
-                        for(i=1;i<10;i++){
-                            _ob[i] = eeprom_read_byte(_response_5F000000+i);
-                        }
-                        _ob[0] = 0x102;
-                        _ob[10] = 0x100;
-                        _ob_x = 0;
-                        _ob_len = 11;
+                        _respond(RSP_EE, _response_5F000000+1, 9, 0x102, 0x100);
                         break;
 
                     case 0x01:
                         io_write(0x101);
 
-                        _ob_x = 0;
-                        _ob_len = 0;
-
-                        for(i=1;i<10;i++){
-                            _ob[i] = eeprom_read_byte(_response_5F000100+i);
-                        }
-                        _ob[0] = 0x102;
-                        _ob[10] = 0x100;
-                        _ob_x = 0;
-                        _ob_len = 11;
+                        _respond(RSP_EE, _response_5F000100+1, 9, 0x102, 0x100);
                         break;
 
                     case 0x02:
@@ -402,53 +609,113 @@ void _command(uint16_t cmd)
     case 0x0611:
                 io_write(0x101);
 
-                keyindex = (cmd & 0xF0) >> 5;
-
-                _ob_x = 0;
-                _ob_len = 0;
+                keyindex = pgm_read_byte(&_ecm_keyindex[(cmd >> 4) & 3]);
 
+                /* a previous CW the decoder is still fetching stays
+                 * fetchable until this one is done, an unread one goes */
                 for(i = 0; i < 16; i += 2)
                 {
-                    _ob[i + 0] = io_read();
-                    _ob[i + 1] = io_read();
+                    _ib[i + 0] = io_read();
+                    _ib[i + 1] = io_read();
                     io_write(0x101);
                 }
-
-                if(cryptmode == 0){
+                _response_drop_unread();
+#ifdef _deadline
+                tick_start(&_ecm_deadline, _slack.deadline);
+#endif // _deadline
+
+#ifdef _perf
+                t = tick_count();
+#endif // _perf
+                sched_begin(SCHED_CRYPT, TICKS_US(SCHED_CRYPT_US));
+                TRACE(TRACE_CRYPT, profile.cryptmode);
+                if(profile.cryptmode == 0){
                     _rand_seed_des(keyindex,cmd & 0xFF);
+#ifdef _perf
+                    perf_span(&perf.des, tick_cycles_since(t));
+#endif // _perf
+                } else if(profile.cryptmode == 3){
+                    _rand_seed_speck(keyindex);
+#ifdef _perf
+                    perf.speck = tick_cycles_since(t);
+#endif // _perf
                 } else {
                     _rand_seed_xtea(keyindex);
+#ifdef _perf
+                    if(profile.cryptmode == 2) perf_span(&perf.xtea, tick_cycles_since(t));
+#endif // _perf
                 }
+                TRACE(TRACE_CRYPT_END, check);
+                sched_end();
+                PERF_INC(ecms);
                 if(check == 0){
-                    _ob[0] = 0x106;
-                    _ob[9] = 0x102;
-                    _ob_x = 0;
-                    _ob_len = 10;
+                    _ecm_answer(0x106);
                 } else {
-                    _ob[0] = 0x10A;
-                    _ob_x = 0;
-                    _ob_len = 1;
+                    PERF_INC(check_fail);
+                    _ecm_answer(0x10A);
                 } break;
+#ifdef _perf
+    case 0x3000:
+    case 0x3001:
+    case 0x3002:
+    case 0x3003:
+    case 0x3004:
+    case 0x3005:
+    case 0x3006:
+    case 0x3007:
+    case 0x3008:
+    case 0x3009:
+                io_write(0x101);
+
+                perf_page(cmd & 0x0F, _out[_back]);
+                _publish(0x102, 0x100);
+                break;
+    case 0x30FF:
+                io_write(0x1FF);
+
+                perf_init(); break;
+#endif // _perf
+#ifdef _trace
+    case 0x3100:
+                trace_dump(); break;
+#endif // _trace
+#ifdef _deadline
+    case 0x3200:
+                io_write(0x101);
+
+                memcpy(_out[_back], &_slack, 8);
+                _publish(0x102, 0x100);
+                break;
+    case 0x3201:
+                io_write(0x101);
+
+                c = io_read() & 0xFF;
+                c |= (io_read() & 0xFF) << 8;
+                _slack.deadline = c;
+                _slack.min = 0xFFFF;
+                _slack.missed = 0;
+                io_write(0x100);
+                break;
+#endif // _deadline
 	case 0xFFFF:
-                c = 0x101;
-                if(_ob_len > 0)
-                {
-                    c = _ob[_ob_x];
-                    _ob_x++;
-                    _ob_len--;
-                if(_ob_x == 16)
-                {
-                    _ob_x = 0;
-                }
+#ifdef _deadline
+                if(_held){
+                    if(!tick_expired(&_ecm_deadline)){
+                        io_write(0x101);
+                        break;
+                    }
+                    _ecm_publish(_held);
+                    _held = 0;
                 }
-                io_write(c);
+#endif // _deadline
+                io_write(_response_next());
                 break;
     default:
             io_write(0x101);
 
             break;
 	}
-
+	TRACE(TRACE_CMD_END, cmd >> 8);
 }
 
 int main(void)
@@ -459,23 +726,48 @@ int main(void)
 	/* Enable interrupts */
 	sei();
 
+    tick_init();
     io_init();
+#ifdef _perf
+    perf_init();
+#endif // _perf
     enable_rx();
 
 	a = b = 0;
 
-    cryptmode = eeprom_read_byte(&_cryptmode);
-    atrindex = eeprom_read_byte(&_atrindex);
-	eeprom_read_block(&_mindate,&_response_5F000000[8],2);
-	eeprom_read_block(&_maxdate,&_response_5F000100[6],2);
-
-
+    /* everything the first ECM needs is in RAM from here on */
+    image_check();
+    eelog_init();
+    _load_settings();
+#ifdef _perf
+    perf.boot = tick_now();
+#endif // _perf
+
+#ifdef _sched
+    sched_init();
+    /* a command that stalled past its deadline lands here */
+    if(setjmp(sched_env))
+        io_flush();
+    a = b = 0;
+#endif // _sched
 
 	while(1)
 	{
 
+		/* a decoder polling faster than RX_TIMEOUT_US never lets the
+		   line go quiet, kick the watchdog for every frame */
+		sched_yield();
+
 		a = b;
-		b = io_read();
+		b = io_read_timeout(TICKS_US(RX_TIMEOUT_US));
+
+		if(b == IO_TIMEOUT)
+		{
+			/* line went quiet, drop a half received command */
+			b = 0;
+			sched_run();
+			continue;
+		}
 
 		if((a & 0x100) == 0x100 &&
 		   (b & 0x100) == 0x000)
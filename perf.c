@@ -0,0 +1,59 @@
+#include "config.h"
+#include "perf.h"
+
+#ifdef _perf
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <string.h>
+
+perf_t perf;
+
+void perf_init(void)
+{
+    memset(&perf, 0, sizeof(perf));
+    perf.des.min = perf.xtea.min = 0xFFFFFFFF;
+}
+
+void perf_span(perf_span_t *s, uint32_t cycles)
+{
+    s->last = cycles;
+    if (cycles < s->min) s->min = cycles;
+    if (cycles > s->max) s->max = cycles;
+}
+
+static uint8_t perf_class(uint8_t c)
+{
+    switch(c){
+        case 0x01: return 0;
+        case 0x02: return 1;
+        case 0x04: return 2;
+        case 0x05: return 3;
+        case 0x06: return 4;
+        case 0x14: return 5;
+        case 0x24:
+        case 0x25:
+        case 0x26: return 6;
+        case 0x57: return 7;
+        case 0x5E: return 8;
+        case 0x5F: return 9;
+        case 0x30: return 10;
+        case 0xFF: return 11;
+    }
+    return PERF_CLASSES - 1;
+}
+
+void perf_command(uint16_t cmd)
+{
+    perf.cmds[perf_class(cmd >> 8)]++;
+}
+
+void perf_page(uint8_t page, uint8_t *out)
+{
+    uint8_t sreg = SREG;
+    cli();
+    memcpy(out, ((uint8_t *) &perf) + page * 8, 8);
+    SREG = sreg;
+}
+
+#endif // _perf
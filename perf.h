@@ -0,0 +1,55 @@
+#ifndef _PERF_H_
+#define _PERF_H_
+
+#include "config.h"
+#include <avr/io.h>
+
+/* Command classes counted by perf.cmds[], index = perf_class(cmd >> 8) */
+#define PERF_CLASSES 16
+
+typedef struct
+{
+    uint32_t min;
+    uint32_t max;
+    uint32_t last;
+} perf_span_t;
+
+/* Laid out in 8-byte pages, page n is returned by command 0x300n */
+typedef struct
+{
+    uint16_t ecms;              /* page 0 */
+    uint16_t check_fail;
+    uint16_t fifo_overflow;
+    uint16_t frame_errors;
+    uint16_t busy;              /* page 1 */
+    uint16_t rx_votes;          /* RX bits with disagreeing samples */
+    uint16_t rx_errsig;         /* retransmits requested */
+    uint16_t boot;              /* ticks, reset to first command */
+    perf_span_t des;            /* pages 2..4, cycles */
+    perf_span_t xtea;
+    uint16_t cmds[PERF_CLASSES];    /* pages 5..8 */
+    uint16_t sched_aborts;      /* page 9, commands dropped on a deadline */
+    uint16_t sched_late;        /* crypto/EEPROM over their deadline */
+    uint32_t speck;             /* cycles, last cryptmode 3 ECM */
+} perf_t;
+
+#define PERF_PAGES (sizeof(perf_t) / 8)
+
+#ifdef _perf
+
+extern perf_t perf;
+
+#define PERF_INC(c) (perf.c++)
+
+extern void perf_init(void);
+extern void perf_span(perf_span_t *s, uint32_t cycles);
+extern void perf_command(uint16_t cmd);
+extern void perf_page(uint8_t page, uint8_t *out);
+
+#else // _perf
+
+#define PERF_INC(c) do {} while(0)
+
+#endif // _perf
+
+#endif /* _PERF_H_ */
@@ -0,0 +1,48 @@
+#include "config.h"
+#include "profile.h"
+#include "systerdes.h"
+#include "keystore.h"
+
+#include <avr/io.h>
+#include <avr/eeprom.h>
+
+/* XTEA KEYS, see main.c */
+extern uint32_t _xtea_key[2][4];
+
+profile_t _profile[PROFILES] EEMEM = {
+    /* Premiere DE */
+    {{0xA0,0x02,0x1C,0x38,0x14,0x05,0xFF,0x14,0xE1,0xE5,0x00}, 0, 0, PROFILE_MODE_ANY},
+    /* C+ France */
+    {{0xA0,0x02,0x18,0x38,0x12,0x00,0xFF,0x14,0x80,0x83,0x00}, 1, 0, PROFILE_MODE_ANY},
+    /* C+ Poland */
+    {{0xA0,0x02,0x1C,0xE0,0x0C,0x01,0xFF,0x14,0xE1,0xE5,0x00}, 2, 0, PROFILE_MODE_ANY},
+    /* reserved, Premiere answer on the reserved key slots */
+    {{0xA0,0x02,0x1C,0x38,0x14,0x05,0xFF,0x14,0xE1,0xE5,0x00}, 3, 0, PROFILE_MODE_ANY},
+};
+
+profile_active_t profile;
+
+/* Load the profile and everything an ECM needs into RAM, so the first
+ * ECM after a switch costs the same as any other.
+ */
+void profile_select(uint8_t atrindex, uint8_t cryptmode)
+{
+    profile_t *p = &_profile[atrindex & (PROFILES - 1)];
+    uint8_t i, op, k64[8];
+
+    profile.response_0200 = p->response_0200;
+    profile.datecheck = (atrindex & 0x10) || (eeprom_read_byte(&p->flags) & PROFILE_DATECHECK);
+    profile.cryptmode = eeprom_read_byte(&p->cryptmode);
+    if(profile.cryptmode == PROFILE_MODE_ANY)
+        profile.cryptmode = cryptmode;
+
+    if(profile.cryptmode == 0){
+        op = eeprom_read_byte(&p->keyop) & (PROFILES - 1);
+        for(i=0;i<KEY_INDEXES;i++){
+            keystore_key(op,i,k64);
+            _syster_key56(k64,profile.key.des[i]);
+        }
+    } else {
+        eeprom_read_block(profile.key.xtea,_xtea_key,sizeof(profile.key.xtea));
+    }
+}
@@ -0,0 +1,42 @@
+#ifndef _PROFILE_H_
+#define _PROFILE_H_
+
+#include "config.h"
+#include <avr/io.h>
+
+/* Operator profiles, selected by the low nibble of the ATR index
+ * (0x140N). Bit 4 of the ATR index (0x141N) forces date checking on
+ * top of the profile's own policy.
+ */
+#define PROFILES 4
+
+#define PROFILE_DATECHECK 0x01      /* check ECM date and audience */
+#define PROFILE_MODE_ANY  0xFF      /* use the mode set with 0x04xx */
+
+typedef struct
+{
+    uint8_t response_0200[11];
+    uint8_t keyop;                  /* operator tag of its key slots */
+    uint8_t flags;
+    uint8_t cryptmode;
+} profile_t;
+
+/* RAM copy of the selected profile with ready to use keys */
+typedef struct
+{
+    const uint8_t *response_0200;   /* EEPROM */
+    uint8_t datecheck;
+    uint8_t cryptmode;
+    union
+    {
+        uint8_t des[3][8];          /* 56-bit keys by KEY_INDEXES, see keystore.h */
+        uint32_t xtea[2][4];        /* also Speck, cryptmode 3 */
+    } key;
+} profile_active_t;
+
+extern profile_t _profile[PROFILES];
+extern profile_active_t profile;
+
+extern void profile_select(uint8_t atrindex, uint8_t cryptmode);
+
+#endif /* _PROFILE_H_ */
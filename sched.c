@@ -0,0 +1,76 @@
+#include "config.h"
+#include "sched.h"
+#include "image.h"
+#include "perf.h"
+#include "trace.h"
+
+#include <avr/io.h>
+#include <avr/wdt.h>
+
+#ifdef _sched
+
+jmp_buf sched_env;
+uint8_t sched_task;
+
+static tick_timer_t sched_deadline;
+static uint8_t sched_pending;
+
+void sched_init(void)
+{
+    sched_task = SCHED_IDLE;
+    wdt_enable(WDTO_250MS);
+}
+
+void sched_begin(uint8_t task, tick_t len)
+{
+    wdt_reset();
+    sched_task = task;
+    tick_start(&sched_deadline, len);
+}
+
+/* Returns 1 if the task overran its deadline */
+uint8_t sched_end(void)
+{
+    uint8_t late = sched_task != SCHED_IDLE && tick_expired(&sched_deadline);
+
+    if(late)
+        PERF_INC(sched_late);
+    sched_task = SCHED_IDLE;
+    wdt_reset();
+    return late;
+}
+
+void sched_yield(void)
+{
+    wdt_reset();
+    if(sched_task == SCHED_IO && tick_expired(&sched_deadline))
+        sched_abort();
+}
+
+void sched_abort(void)
+{
+    PERF_INC(sched_aborts);
+    TRACE(TRACE_ABORT, sched_task);
+    sched_task = SCHED_IDLE;
+    longjmp(sched_env, 1);
+}
+
+/* For SCHED_EEPROM the caller marks the image stale before writing */
+void sched_post(uint8_t task)
+{
+    sched_pending |= 1 << task;
+}
+
+/* Called from the main loop while the line is quiet */
+void sched_run(void)
+{
+    if(sched_pending & (1 << SCHED_EEPROM)){
+        sched_pending &= ~(1 << SCHED_EEPROM);
+        sched_begin(SCHED_EEPROM, TICKS_US(SCHED_EEPROM_US));
+        image_seal();
+        sched_end();
+    }
+    wdt_reset();
+}
+
+#endif // _sched
@@ -0,0 +1,49 @@
+#ifndef _SCHED_H_
+#define _SCHED_H_
+
+#include "config.h"
+#include "tick.h"
+#include <avr/io.h>
+
+/* Cooperative tasks with deadlines, the watchdog catches whatever stops
+ * yielding. A command exchange (SCHED_IO) that waits past its deadline
+ * for the decoder is aborted: sched_abort() unwinds to the setjmp() in
+ * main(), which drops the command and resyncs the a/b detection. Crypto
+ * and EEPROM work can't be cut off halfway and are only counted as late.
+ * EEPROM write-back posted with sched_post() runs once the line is quiet.
+ * The main loop yields once per frame, so the watchdog is kicked even
+ * when the decoder never lets the line go quiet.
+ */
+#define SCHED_IDLE   0
+#define SCHED_IO     1          /* waiting for the decoder inside a command */
+#define SCHED_CRYPT  2
+#define SCHED_EEPROM 3          /* image seal, posted */
+
+#ifdef _sched
+
+#include <setjmp.h>
+
+extern jmp_buf sched_env;
+extern uint8_t sched_task;
+
+extern void sched_init(void);
+extern void sched_begin(uint8_t task, tick_t len);
+extern uint8_t sched_end(void);
+extern void sched_yield(void);
+extern void sched_abort(void) __attribute__((noreturn));
+extern void sched_post(uint8_t task);
+extern void sched_run(void);
+
+#else // _sched
+
+#include "image.h"
+
+#define sched_begin(t, l) do {} while(0)
+#define sched_end() do {} while(0)
+#define sched_yield() do {} while(0)
+#define sched_post(t) image_seal()
+#define sched_run() do {} while(0)
+
+#endif // _sched
+
+#endif /* _SCHED_H_ */
@@ -21,6 +21,7 @@
 #include <string.h>
 #include "systerdes.h"
 #include <avr/pgmspace.h>
+#include "crypto.h"
 
 /* Key left shift table */
 PROGMEM uint8_t const LS[] = { 1, 2, 2, 2, 2, 2, 2, 1, 2, 2, 2, 2, 2, 2, 1, 0 };
@@ -78,7 +79,7 @@ PROGMEM uint8_t const fp[] = { 7, 3, 6, 2, 5, 1, 4, 0 };
 void _permute(uint8_t *in, uint8_t *buffer1, const uint8_t *p)
 {
 	int i, j;
-	uint8_t T[8];
+	uint8_t *T = crypto.des.T;
 
 	memcpy(T, in, 8);
 
@@ -143,14 +144,14 @@ void _syster_des_f(uint8_t *k, uint8_t *cw)
 	uint8_t i; //int
 
 	/* Expanded key and control word */
-	uint8_t ecw[8], ek[8];
+	uint8_t *ecw = crypto.des.ecw, *ek = crypto.des.ek;
 
 	for(i = 0; i < 16; i++)
 	{
 		uint8_t c, j; //int
 
 		/* Right half of decoded 8-bit CW */
-		uint8_t r[4];
+		uint8_t *r = crypto.des.r;
 
 		/* Key expansion */
 		_expand(C, k, ek);
@@ -194,28 +195,34 @@ void _syster_des_f(uint8_t *k, uint8_t *cw)
 	}
 }
 
-uint16_t _get_syster_cw(uint8_t ecm[16], uint8_t k64[8],uint8_t *out)
+/* Convert 64-bit key to the 56-bit key _syster_des_f works on */
+void _syster_key56(uint8_t k64[8], uint8_t *k56)
+{
+	_permute(k64, k56, kp);
+	k56[0] = k56[4] << 4;
+}
+
+uint16_t _get_syster_cw(uint8_t ecm[16], const uint8_t k56[8],uint8_t *out)
 {
 	uint8_t round, i;
 	uint16_t date;
-	uint8_t buffer1[8], cw[8], pcw[8];
+	uint8_t *buffer1 = crypto.des.buffer1, *pcw = crypto.des.pcw;
 
 
     /* Run twice - one for each half of the 16-byte encrypted control word */
 	for(round = 0; round < 2; round++)
 	{
-		unsigned char k56[8], buffer2[8];
+		uint8_t *k = crypto.des.k, *buffer2 = crypto.des.buffer2;
         //uint8_t audi = *aud;
 
-		/* Convert 64-bit key to 56-bit key */
-		_permute(k64, k56, kp);
-		k56[0] = k56[4] << 4;
+		/* Fresh copy of the 56-bit key, _syster_des_f rotates it */
+		memcpy(k, k56, 8);
 
 		/* Initial CW permutation */
 		_permute(ecm + round * 8, pcw, ip);
 
 		/* Call main DES function */
-		_syster_des_f(k56, pcw);
+		_syster_des_f(k, pcw);
 
 		/* Final permutation of CW */
 		_permute(pcw, buffer2, fp);
@@ -235,13 +242,12 @@ uint16_t _get_syster_cw(uint8_t ecm[16], uint8_t k64[8],uint8_t *out)
 	/* Create final decoded control word */
 	for(i = 0; i < 4; i++)
 	{
-		cw[i] = buffer1[i + 4] & (i == 3 ? 0x7F : 0xFF);
+		out[i] = buffer1[i + 4] & (i == 3 ? 0x7F : 0xFF);
 	}
-	cw[4] = buffer1[0] << 1 | (buffer1[7] >> 7 & 1);
-	cw[5] = buffer1[1] << 1 | (buffer1[0] >> 7 & 1);
-	cw[6] = buffer1[2] << 1 | (buffer1[1] >> 7 & 1);
-	cw[7] = ((buffer1[3] << 1 & 0x1F) | (buffer1[2] >> 7 & 1));
+	out[4] = buffer1[0] << 1 | (buffer1[7] >> 7 & 1);
+	out[5] = buffer1[1] << 1 | (buffer1[0] >> 7 & 1);
+	out[6] = buffer1[2] << 1 | (buffer1[1] >> 7 & 1);
+	out[7] = ((buffer1[3] << 1 & 0x1F) | (buffer1[2] >> 7 & 1));
 
-	memcpy(out,cw,8);
 	return date;
 }
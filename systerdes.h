@@ -19,6 +19,7 @@
 #ifndef _SYSTER_DES_H
 #define _SYSTER_DES_H
 
-extern uint16_t _get_syster_cw(uint8_t ecm[16], uint8_t k64[8],uint8_t *out);
+extern void _syster_key56(uint8_t k64[8], uint8_t *k56);
+extern uint16_t _get_syster_cw(uint8_t ecm[16], const uint8_t k56[8],uint8_t *out);
 
 #endif
@@ -0,0 +1,44 @@
+#include "config.h"
+#include "tick.h"
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+volatile uint16_t tick_ovf;
+
+ISR (TIMER0_OVF_vect)
+{
+    tick_ovf++;
+}
+
+void tick_init(void)
+{
+    uint8_t sreg = SREG;
+    cli();
+    TCNT0 = 0;
+    TCCR0 = (1 << CS01);
+    TIFR = (1 << TOV0);
+    TIMSK |= (1 << TOIE0);
+    SREG = sreg;
+}
+
+/* 24-bit tick count, for latency measurements longer than tick_now() spans */
+uint32_t tick_count(void)
+{
+    uint8_t sreg = SREG;
+    cli();
+    uint8_t t = TCNT0;
+    uint16_t o = tick_ovf;
+
+    if ((TIFR & (1 << TOV0)) && t < 0x80)
+        o++;
+    SREG = sreg;
+
+    return (((uint32_t) o) << 8) | t;
+}
+
+/* CPU cycles since a tick_count(), across its wrap every 2^24 ticks */
+uint32_t tick_cycles_since(uint32_t start)
+{
+    return ((tick_count() - start) & 0xFFFFFFUL) * TICK_PRESCALE;
+}
@@ -0,0 +1,59 @@
+#ifndef _TICK_H_
+#define _TICK_H_
+
+#include "config.h"
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+/* Timer0 runs free at F_CPU/8, one tick is 8 cycles (~2.1us at
+ * 26.625MHz/7). tick_now() wraps after 65536 ticks (~138ms), so
+ * timeouts have to stay below that.
+ */
+#define TICK_PRESCALE 8
+#define TICKS_US(us) ((tick_t) (((F_CPU) / TICK_PRESCALE / 1000UL) * (us) / 1000UL))
+
+typedef uint16_t tick_t;
+
+/* Software one-shot timer */
+typedef struct
+{
+    tick_t start;
+    tick_t len;
+} tick_timer_t;
+
+extern volatile uint16_t tick_ovf;
+
+extern void tick_init(void);
+extern uint32_t tick_count(void);
+extern uint32_t tick_cycles_since(uint32_t start);
+
+static inline tick_t
+tick_now(void)
+{
+    uint8_t sreg = SREG;
+    cli();
+    uint8_t t = TCNT0;
+    uint8_t o = tick_ovf;
+
+    /* overflow pending but not yet serviced */
+    if ((TIFR & (1 << TOV0)) && t < 0x80)
+        o++;
+    SREG = sreg;
+
+    return ((tick_t) o << 8) | t;
+}
+
+static inline void
+tick_start(tick_timer_t *t, const tick_t len)
+{
+    t->start = tick_now();
+    t->len = len;
+}
+
+static inline uint8_t
+tick_expired(const tick_timer_t *t)
+{
+    return (tick_t) (tick_now() - t->start) >= t->len;
+}
+
+#endif /* _TICK_H_ */
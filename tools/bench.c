@@ -0,0 +1,252 @@
+/* Cycle-accurate command benchmark for the syster card firmware          */
+/*=======================================================================*/
+/*                                                                       */
+/* This program is free software: you can redistribute it and/or modify  */
+/* it under the terms of the GNU General Public License as published by  */
+/* the Free Software Foundation, either version 3 of the License, or     */
+/* (at your option) any later version.                                   */
+/*                                                                       */
+/* This program is distributed in the hope that it will be useful,       */
+/* but WITHOUT ANY WARRANTY; without even the implied warranty of        */
+/* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         */
+/* GNU General Public License for more details.                          */
+/*                                                                       */
+/* You should have received a copy of the GNU General Public License     */
+/* along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+
+/* Usage: bench [-m mcu] [-f f_cpu] [-b baud] [-s symfile] [-t script]
+ *              [-B boot budget usec] [-r transcript] elf
+ *
+ * Output is tab separated, one record per line:
+ *
+ *   boot <cycles> <usec> <budget> ok|over
+ *   cmd  <name> <command> <cycles> <usec> <frames> ok|timeout|bad
+ *   fn   <name> <function> <calls> <cycles> <usec>
+ *   resets <count>
+ *
+ * boot runs from reset to the first io_read_timeout() of the main loop,
+ * i.e. ready for the first command, and needs -s. Symbols without
+ * io_read_timeout (inlined by -flto, or from another build) give
+ * "boot - - <budget> nosym" and fail, rather than skip the budget.
+ *
+ * A script line may end in =<frame>, the card's answer to the last pair
+ * sent before any fetch, e.g. =100; any other answer is "bad".
+ *
+ * cycles run from the first command frame to the last reply frame, fn
+ * rows are inclusive cycles of each firmware function during that command.
+ * resets counts core resets after power-on, i.e. the watchdog firing,
+ * and fails the run when it isn't 0.
+ * With -r every frame on the line is also recorded, see transcript.h.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "simcard.h"
+#include "transcript.h"
+
+#define BENCH_TIMEOUT   4000000     /* cycles to wait for one reply frame */
+#define BENCH_MAXPOLLS  64
+#define BENCH_GAP       5           /* decoder turnaround in ETU, 16 start to start */
+
+static simcard_t sim;
+static transcript_t rec;
+
+static double _usec(avr_cycle_count_t c)
+{
+	return (double) c * 1000000.0 / sim.freq;
+}
+
+/* Send one pair and collect the single frame the card answers with */
+static int _pair(uint16_t a, uint16_t b, uint16_t *reply)
+{
+	if(simcard_send(&sim, a) < 0 || simcard_send(&sim, b) < 0)
+		return -1;
+	if(simcard_recv(&sim, reply, BENCH_TIMEOUT) < 0)
+		return -1;
+	return simcard_run_until(&sim, sim.avr->cycle + BENCH_GAP * sim.etu);
+}
+
+static int _fetch(int *frames)
+{
+	uint16_t c = 0x101;
+	int i;
+
+	/* wait for the reply header, then drain until the card idles */
+	for(i = 0; i < BENCH_MAXPOLLS && c == 0x101; i++)
+		if(_pair(0x1FF, 0x0FF, &c) < 0)
+			return -1;
+	if(c == 0x101)
+		return -1;
+	for(*frames += 1; i < BENCH_MAXPOLLS; i++, *frames += 1)
+	{
+		if(_pair(0x1FF, 0x0FF, &c) < 0)
+			return -1;
+		if(c == 0x101)
+			return 0;
+	}
+	return -1;
+}
+
+static int _boot(uint32_t budget)
+{
+	int f = simcard_find_func(&sim, "io_read_timeout");
+	double us;
+
+	if(f < 0 && !sim.nfuncs && !budget)
+		return 0;
+	if(f < 0)
+	{
+		printf("boot\t-\t-\t%u\tnosym\n", budget);
+		return -1;
+	}
+	while(sim.avr->pc != sim.func[f].addr)
+		if(sim.avr->cycle >= BENCH_TIMEOUT || simcard_step(&sim) < 0)
+		{
+			printf("boot\t-\t-\t%u\ttimeout\n", budget);
+			return -1;
+		}
+	us = _usec(sim.avr->cycle);
+	printf("boot\t%llu\t%.1f\t%u\t%s\n", (unsigned long long) sim.avr->cycle, us, budget,
+		budget && us > budget ? "over" : "ok");
+
+	return budget && us > budget ? -1 : 0;
+}
+
+static int _command(char *line)
+{
+	char *name, *tok;
+	unsigned int cmd, b[2], expect = 0;
+	int n = 0, frames = 0, fetch = 0, err = 0, bad = 0, f;
+	uint16_t c;
+	avr_cycle_count_t start, cycles;
+
+	name = strtok(line, " \t\r\n");
+	if(!name || name[0] == '#')
+		return 0;
+	tok = strtok(NULL, " \t\r\n");
+	if(!tok || sscanf(tok, "%x", &cmd) != 1)
+		return -1;
+
+	simcard_reset_profile(&sim);
+	start = sim.avr->cycle;
+
+	err = _pair(0x100 | (cmd >> 8), cmd & 0xFF, &c);
+	frames++;
+
+	while(!err && (tok = strtok(NULL, " \t\r\n")))
+	{
+		if(strcmp(tok, "fetch") == 0)
+		{
+			fetch = 1;
+			continue;
+		}
+		if(tok[0] == '=')
+		{
+			sscanf(tok + 1, "%x", &expect);
+			continue;
+		}
+		sscanf(tok, "%x", &b[n]);
+		if(++n == 2)
+		{
+			err = _pair(b[0], b[1], &c);
+			frames++;
+			n = 0;
+		}
+	}
+	bad = !err && expect && c != expect;
+	if(!err && fetch)
+		err = _fetch(&frames);
+
+	cycles = sim.avr->cycle - start;
+	printf("cmd\t%s\t%04X\t%llu\t%.1f\t%d\t%s\n", name, cmd,
+		(unsigned long long) cycles, _usec(cycles), frames, err ? "timeout" : bad ? "bad" : "ok");
+
+	for(f = 0; f < sim.nfuncs; f++)
+	{
+		if(!sim.func[f].calls)
+			continue;
+		printf("fn\t%s\t%s\t%u\t%llu\t%.1f\n", name, sim.func[f].name, sim.func[f].calls,
+			(unsigned long long) sim.func[f].cycles, _usec(sim.func[f].cycles));
+	}
+
+	return err || bad;
+}
+
+int main(int argc, char *argv[])
+{
+	const char *mcu = NULL, *symfile = NULL, *script = "tools/bench.txt", *record = NULL;
+	uint32_t freq = SIM_F_CPU, baud = SIM_BAUDRATE;
+	char line[1024];                /* a 26 00 image is 272 bytes */
+	FILE *fp;
+	uint32_t boot_budget = 0;
+	int opt, failed = 0;
+
+	while((opt = getopt(argc, argv, "m:f:b:s:t:r:B:")) != -1)
+	{
+		switch(opt)
+		{
+		case 'm': mcu = optarg; break;
+		case 'f': freq = strtoul(optarg, NULL, 0); break;
+		case 'b': baud = strtoul(optarg, NULL, 0); break;
+		case 's': symfile = optarg; break;
+		case 't': script = optarg; break;
+		case 'r': record = optarg; break;
+		case 'B': boot_budget = strtoul(optarg, NULL, 0); break;
+		default:
+			fprintf(stderr, "usage: %s [-m mcu] [-f f_cpu] [-b baud] [-s symfile] [-t script] [-B usec] [-r transcript] elf\n", argv[0]);
+			return 2;
+		}
+	}
+	if(optind >= argc)
+	{
+		fprintf(stderr, "%s: no firmware given\n", argv[0]);
+		return 2;
+	}
+
+	if(simcard_open(&sim, argv[optind], mcu, freq, baud) < 0)
+		return 1;
+	if(symfile && simcard_load_symbols(&sim, symfile) < 0)
+		return 1;
+
+	if(record)
+	{
+		if(tr_create(&rec, record, sim.freq, sim.etu) < 0)
+		{
+			fprintf(stderr, "%s: cannot write %s\n", argv[0], record);
+			return 1;
+		}
+		sim.observe = tr_observe;
+		sim.observe_param = &rec;
+	}
+
+	fp = fopen(script, "r");
+	if(!fp)
+	{
+		fprintf(stderr, "%s: cannot read %s\n", argv[0], script);
+		return 1;
+	}
+
+	printf("# bench\t%s\tmcu=%s\tf_cpu=%u\tetu=%u\n", argv[optind], mcu ? mcu : "elf", freq, sim.etu);
+
+	if(_boot(boot_budget) < 0)
+		failed++;
+
+	/* let the card come out of reset before the first command */
+	simcard_run_until(&sim, 20 * sim.etu);
+
+	while(fgets(line, sizeof(line), fp))
+		if(_command(line) != 0)
+			failed++;
+	fclose(fp);
+	if(record)
+		tr_close(&rec);
+
+	printf("resets\t%u\n", sim.resets);
+	if(sim.resets)
+		failed++;
+
+	return failed ? 1 : 0;
+}
@@ -0,0 +1,140 @@
+/* Card image builder for 26 00 of the syster card firmware              */
+/*=======================================================================*/
+/*                                                                       */
+/* This program is free software: you can redistribute it and/or modify  */
+/* it under the terms of the GNU General Public License as published by  */
+/* the Free Software Foundation, either version 3 of the License, or     */
+/* (at your option) any later version.                                   */
+/*                                                                       */
+/* This program is distributed in the hope that it will be useful,       */
+/* but WITHOUT ANY WARRANTY; without even the implied warranty of        */
+/* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         */
+/* GNU General Public License for more details.                          */
+/*                                                                       */
+/* You should have received a copy of the GNU General Public License     */
+/* along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+
+
+/* Usage: imagegen [-n name] [-m mode] [-a atrindex] [-c] [-e frame]
+ *
+ * Builds a complete 26 00 transfer (image.h, EXTRA-CMDS.txt) and prints
+ * it as a tools/bench.txt line: the name, 2600, the 270 image bytes and
+ * the CRC, low byte first. The image is the card as flashed, key slots,
+ * XTEA keys, channels and subscription records from keystore.c and
+ * main.c; -m and -a set the crypt mode and ATR index it carries. -c
+ * sends the complement of the CRC, for the transfer the card has to
+ * turn down. -e appends "=<frame>", the answer bench expects to the
+ * last pair.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdint.h>
+
+#define KEYSLOTS     16
+#define KEYSLOT_SIZE 13             /* op, index, version, valid_from, key[8] */
+#define KEY_OP_ANY   0x0F
+#define KEY_OP_FREE  0xFF
+#define IMAGE_SIZE   (KEYSLOTS * KEYSLOT_SIZE + 32 + 8 + 10 + 10 + 1 + 1)
+
+/* keystore.c: op, index, key */
+static const struct { uint8_t op, index, key[8]; } _slots[] = {
+	{0, 0, {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x12, 0x34}},
+	{0, 1, {0x00, 0xE2, 0x51, 0x6D, 0x15, 0x97, 0x51, 0x55}},
+	{1, 0, {0x00, 0xAE, 0x52, 0x90, 0x49, 0xF1, 0xF1, 0xBB}},
+	{1, 1, {0x00, 0xE9, 0xEB, 0xB3, 0xA6, 0xDB, 0x3C, 0x87}},
+	{2, 0, {0}},
+	{2, 1, {0}},
+	{3, 0, {0}},
+	{3, 1, {0}},
+	{KEY_OP_ANY, 2, {0xC4, 0xA5, 0xA8, 0x18, 0x74, 0x93, 0xC7, 0x65}},
+};
+
+/* main.c */
+static const uint32_t _xtea_key[2][4] = {
+	{0x00112233, 0x44556677, 0x8899AABB, 0xCCDDEEFF},
+	{0xd5784071, 0x48909110, 0x01260c7a, 0xd5579e9d},
+};
+static const uint8_t _channels[8] = {0x19, 0x01, 0x1A, 0x01, 0x1B, 0x01, 0x1C, 0x01};
+static const uint8_t _sub0[10] = {0x00, 0x01, 0xFF, 0xFF, 0x61, 0x6B, 0xDF, 0xBB, 0x21, 0x80};
+static const uint8_t _sub1[10] = {0x00, 0x01, 0xFF, 0xFF, 0x60, 0x6A, 0xDF, 0xC1, 0x21, 0xBC};
+
+/* avr-libc _crc_ccitt_update */
+static uint16_t _crc_ccitt(uint16_t crc, uint8_t data)
+{
+	data ^= crc & 0xFF;
+	data ^= data << 4;
+
+	return (((uint16_t) data << 8) | (crc >> 8)) ^ (uint8_t) (data >> 4) ^ ((uint16_t) data << 3);
+}
+
+int main(int argc, char *argv[])
+{
+	uint8_t img[IMAGE_SIZE], *p = img;
+	const char *name = "image";
+	unsigned int mode = 0, atr = 0x10, expect = 0;
+	uint16_t crc = 0xFFFF;
+	int opt, i, j, corrupt = 0;
+
+	while((opt = getopt(argc, argv, "n:m:a:ce:")) != -1)
+	{
+		switch(opt)
+		{
+		case 'n': name = optarg; break;
+		case 'm': mode = strtoul(optarg, NULL, 16); break;
+		case 'a': atr = strtoul(optarg, NULL, 16); break;
+		case 'c': corrupt = 1; break;
+		case 'e': expect = strtoul(optarg, NULL, 16); break;
+		default:
+			fprintf(stderr, "usage: %s [-n name] [-m mode] [-a atrindex] [-c] [-e frame]\n", argv[0]);
+			return 2;
+		}
+	}
+
+	/* key slots, valid_from little endian, the rest free */
+	memset(img, 0, sizeof(img));
+	for(i = 0; i < KEYSLOTS; i++, p += KEYSLOT_SIZE)
+	{
+		if(i >= (int) (sizeof(_slots) / sizeof(_slots[0])))
+		{
+			p[0] = KEY_OP_FREE;
+			continue;
+		}
+		p[0] = _slots[i].op;
+		p[1] = _slots[i].index;
+		memcpy(&p[5], _slots[i].key, 8);
+	}
+	for(i = 0; i < 2; i++)
+		for(j = 0; j < 4; j++, p += 4)
+		{
+			p[0] = _xtea_key[i][j];
+			p[1] = _xtea_key[i][j] >> 8;
+			p[2] = _xtea_key[i][j] >> 16;
+			p[3] = _xtea_key[i][j] >> 24;
+		}
+	memcpy(p, _channels, 8);
+	p += 8;
+	memcpy(p, _sub0, 10);
+	p += 10;
+	memcpy(p, _sub1, 10);
+	p += 10;
+	*p++ = mode;
+	*p++ = atr;
+
+	for(i = 0; i < IMAGE_SIZE; i++)
+		crc = _crc_ccitt(crc, img[i]);
+	if(corrupt)
+		crc = ~crc;
+
+	printf("%-12s 2600", name);
+	for(i = 0; i < IMAGE_SIZE; i++)
+		printf(" %02X", img[i]);
+	printf(" %02X %02X", crc & 0xFF, crc >> 8);
+	if(expect)
+		printf(" =%X", expect);
+	printf("\n");
+
+	return 0;
+}
@@ -0,0 +1,320 @@
+/* Decoder load generator for the syster card firmware                   */
+/*=======================================================================*/
+/*                                                                       */
+/* This program is free software: you can redistribute it and/or modify  */
+/* it under the terms of the GNU General Public License as published by  */
+/* the Free Software Foundation, either version 3 of the License, or     */
+/* (at your option) any later version.                                   */
+/*                                                                       */
+/* This program is distributed in the hope that it will be useful,       */
+/* but WITHOUT ANY WARRANTY; without even the implied warranty of        */
+/* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         */
+/* GNU General Public License for more details.                          */
+/*                                                                       */
+/* You should have received a copy of the GNU General Public License     */
+/* along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+
+/* Usage: loadgen [-m mcu] [-f f_cpu] [-b baud] [-x mix] [-d seconds]
+ *                [-p poll usec] [-t frame usec] [-T fetch usec]
+ *                [-q quiet usec] [-z storm] [-s seed] elf
+ *
+ * Plays a decoder for -d simulated seconds. Each line of the mix file
+ * (tools/loadgen.txt) is a command the decoder sends every <period> ms,
+ * give or take <jitter> ms; while nothing is due it polls FF FF every
+ * -p usec. Period 0 sends the command once at the start, in file order,
+ * the way a decoder sets up the card before it tunes in. -z divides all
+ * mix periods, -z 20 makes a zap storm out of the normal mix.
+ *
+ * Timeouts are the decoder's: a frame not answered within -t, or a
+ * reply not complete within -T of the command, counts as a timeout.
+ * The decoder then keeps the line quiet for -q usec, long enough for
+ * the card to drop the command, and carries on. Output is tab
+ * separated:
+ *
+ *   load <commands> <seconds> <commands/s> <frames/s> <timeouts>
+ *   lat  <name> <count> <timeouts> <p50> <p99> <max>
+ *   resets <count>
+ *
+ * lat is usec from the first command frame to the last reply frame,
+ * successful commands only. resets counts watchdog resets of the card.
+ * Exits 1 if anything timed out or the card was reset.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "simcard.h"
+
+#define LOADGEN_MIXES    32
+#define LOADGEN_PAYLOAD  32
+#define LOADGEN_GAP      5          /* decoder turnaround in ETU, as bench */
+
+typedef struct
+{
+	char name[32];
+	uint16_t cmd;
+	uint8_t payload[LOADGEN_PAYLOAD];
+	int n;
+	int fetch;
+	avr_cycle_count_t period;
+	avr_cycle_count_t jitter;
+	avr_cycle_count_t due;
+
+	int count;
+	int timeouts;
+	int max;
+	double *lat;                    /* usec */
+} mix_t;
+
+static simcard_t sim;
+static mix_t mix[LOADGEN_MIXES + 1];    /* + the FF FF poll */
+static int nmix;
+static avr_cycle_count_t frame_timeout, fetch_timeout, quiet;
+static uint32_t seed = 1;
+static long frames;
+
+static avr_cycle_count_t _cycles(double usec)
+{
+	return (avr_cycle_count_t) (usec * sim.freq / 1000000.0);
+}
+
+static uint32_t _rand(void)
+{
+	seed = seed * 1103515245 + 12345;
+	return (seed >> 8) & 0xFFFFFF;
+}
+
+static avr_cycle_count_t _next(mix_t *m)
+{
+	avr_cycle_count_t j = m->jitter ? _rand() % (2 * m->jitter + 1) : 0;
+
+	return m->period + j > m->jitter ? m->period + j - m->jitter : 1;
+}
+
+/* <name> <period ms> <jitter ms> <command> [payload bytes] [fetch] */
+static int _load(const char *file, int storm)
+{
+	char line[512], *tok;
+	unsigned int v;
+	double period, jitter;
+	FILE *fp = fopen(file, "r");
+	mix_t *m;
+
+	if(!fp)
+		return -1;
+	while(fgets(line, sizeof(line), fp) && nmix < LOADGEN_MIXES)
+	{
+		m = &mix[nmix];
+		tok = strtok(line, " \t\r\n");
+		if(!tok || tok[0] == '#')
+			continue;
+		memset(m, 0, sizeof(*m));
+		snprintf(m->name, sizeof(m->name), "%s", tok);
+		if(!(tok = strtok(NULL, " \t\r\n")) || sscanf(tok, "%lf", &period) != 1 ||
+		   !(tok = strtok(NULL, " \t\r\n")) || sscanf(tok, "%lf", &jitter) != 1 ||
+		   !(tok = strtok(NULL, " \t\r\n")) || sscanf(tok, "%x", &v) != 1)
+		{
+			fprintf(stderr, "loadgen: bad mix line for %s\n", m->name);
+			fclose(fp);
+			return -1;
+		}
+		m->cmd = v;
+		m->period = _cycles(period * 1000.0 / storm);
+		m->jitter = _cycles(jitter * 1000.0 / storm);
+		while((tok = strtok(NULL, " \t\r\n")))
+		{
+			if(strcmp(tok, "fetch") == 0)
+				m->fetch = 1;
+			else if(m->n < LOADGEN_PAYLOAD && sscanf(tok, "%x", &v) == 1)
+				m->payload[m->n++] = v;
+		}
+		m->n &= ~1;
+		nmix++;
+	}
+	fclose(fp);
+
+	return nmix ? 0 : -1;
+}
+
+/* One pair, one answer, decoder timeout per frame */
+static int _pair(uint16_t a, uint16_t b, uint16_t *reply)
+{
+	if(simcard_send(&sim, a) < 0 || simcard_send(&sim, b) < 0)
+		return -1;
+	frames += 2;
+	if(simcard_recv(&sim, reply, frame_timeout) < 0)
+		return -1;
+	frames++;
+	return simcard_run_until(&sim, sim.avr->cycle + LOADGEN_GAP * sim.etu);
+}
+
+static int _fetch(avr_cycle_count_t start)
+{
+	uint16_t c = 0x101;
+
+	/* 0x101 until the reply is ready, then drain until the card idles */
+	while(c == 0x101)
+	{
+		if(sim.avr->cycle - start > fetch_timeout || _pair(0x1FF, 0x0FF, &c) < 0)
+			return -1;
+	}
+	while(1)
+	{
+		if(sim.avr->cycle - start > fetch_timeout || _pair(0x1FF, 0x0FF, &c) < 0)
+			return -1;
+		if(c == 0x101)
+			return 0;
+	}
+}
+
+static int _exchange(mix_t *m)
+{
+	avr_cycle_count_t start = sim.avr->cycle;
+	uint16_t c;
+	int i, err;
+
+	err = _pair(0x100 | (m->cmd >> 8), m->cmd & 0xFF, &c);
+	for(i = 0; !err && i < m->n; i += 2)
+		err = _pair(m->payload[i], m->payload[i + 1], &c);
+	if(!err && m->fetch)
+		err = _fetch(start);
+
+	if(err)
+	{
+		/* a decoder gives the card time to drop the command */
+		m->timeouts++;
+		simcard_run_until(&sim, sim.avr->cycle + quiet);
+		sim.rxq_tail = sim.rxq_head;
+		return -1;
+	}
+
+	if(m->count == m->max)
+	{
+		m->max = m->max ? m->max * 2 : 256;
+		m->lat = realloc(m->lat, m->max * sizeof(double));
+	}
+	m->lat[m->count++] = (double) (sim.avr->cycle - start) * 1000000.0 / sim.freq;
+
+	return 0;
+}
+
+static int _cmp(const void *a, const void *b)
+{
+	double x = *(const double *) a, y = *(const double *) b;
+
+	return x < y ? -1 : x > y;
+}
+
+static void _report(mix_t *m)
+{
+	int n = m->count;
+
+	if(n == 0)
+	{
+		printf("lat\t%s\t0\t%d\t-\t-\t-\n", m->name, m->timeouts);
+		return;
+	}
+	qsort(m->lat, n, sizeof(double), _cmp);
+	printf("lat\t%s\t%d\t%d\t%.1f\t%.1f\t%.1f\n", m->name, n, m->timeouts,
+		m->lat[n / 2], m->lat[(n * 99) / 100], m->lat[n - 1]);
+}
+
+int main(int argc, char *argv[])
+{
+	const char *mcu = NULL, *file = "tools/loadgen.txt";
+	uint32_t freq = SIM_F_CPU, baud = SIM_BAUDRATE;
+	double seconds = 60, poll = 200000, t_frame = 50000, t_fetch = 1000000, t_quiet = 150000;
+	int opt, storm = 1, m, commands = 0, timeouts = 0;
+	uint32_t seed0;
+	avr_cycle_count_t base, end;
+	mix_t *next;
+
+	while((opt = getopt(argc, argv, "m:f:b:x:d:p:t:T:q:z:s:")) != -1)
+	{
+		switch(opt)
+		{
+		case 'm': mcu = optarg; break;
+		case 'f': freq = strtoul(optarg, NULL, 0); break;
+		case 'b': baud = strtoul(optarg, NULL, 0); break;
+		case 'x': file = optarg; break;
+		case 'd': seconds = atof(optarg); break;
+		case 'p': poll = atof(optarg); break;
+		case 't': t_frame = atof(optarg); break;
+		case 'T': t_fetch = atof(optarg); break;
+		case 'q': t_quiet = atof(optarg); break;
+		case 'z': storm = atoi(optarg) > 0 ? atoi(optarg) : 1; break;
+		case 's': seed = strtoul(optarg, NULL, 0); break;
+		default:
+			fprintf(stderr, "usage: %s [-m mcu] [-f f_cpu] [-b baud] [-x mix] [-d seconds] [-p usec] [-t usec] [-T usec] [-q usec] [-z storm] [-s seed] elf\n", argv[0]);
+			return 2;
+		}
+	}
+	if(optind >= argc)
+	{
+		fprintf(stderr, "%s: no firmware given\n", argv[0]);
+		return 2;
+	}
+
+	if(simcard_open(&sim, argv[optind], mcu, freq, baud) < 0)
+		return 1;
+	if(_load(file, storm) < 0)
+	{
+		fprintf(stderr, "%s: cannot use mix %s\n", argv[0], file);
+		return 1;
+	}
+	seed0 = seed;
+	frame_timeout = _cycles(t_frame);
+	fetch_timeout = _cycles(t_fetch);
+	quiet = _cycles(t_quiet);
+
+	strcpy(mix[nmix].name, "poll");
+	mix[nmix].cmd = 0xFFFF;
+	mix[nmix].period = _cycles(poll);
+	nmix++;
+
+	/* let the card come out of reset, then spread the first commands */
+	simcard_run_until(&sim, 20 * sim.etu);
+	base = sim.avr->cycle;
+	end = base + (avr_cycle_count_t) (seconds * sim.freq);
+	for(m = 0; m < nmix; m++)
+		mix[m].due = mix[m].period ? base + 1 + _rand() % mix[m].period : base;
+
+	printf("# loadgen\t%s\t%s\tstorm=%d\tseed=%u\n", argv[optind], file, storm, seed0);
+
+	while(sim.avr->cycle < end)
+	{
+		next = &mix[0];
+		for(m = 1; m < nmix; m++)
+			if(mix[m].due < next->due)
+				next = &mix[m];
+		if(next->due >= end)
+			break;
+		if(next->due > sim.avr->cycle && simcard_run_until(&sim, next->due) < 0)
+			break;
+
+		if(_exchange(next) < 0)
+			timeouts++;
+		commands++;
+
+		if(!next->period)
+			next->due = (avr_cycle_count_t) -1;
+		else if((next->due += _next(next)) < sim.avr->cycle)
+			next->due = sim.avr->cycle;
+		/* the decoder only polls while it has nothing else to send */
+		mix[nmix - 1].due = sim.avr->cycle + mix[nmix - 1].period;
+	}
+
+	seconds = (double) (sim.avr->cycle - base) / sim.freq;
+	printf("load\t%d\t%.1f\t%.1f\t%.1f\t%d\n", commands, seconds,
+		commands / seconds, frames / seconds, timeouts);
+	for(m = 0; m < nmix; m++)
+	{
+		_report(&mix[m]);
+		free(mix[m].lat);
+	}
+	printf("resets\t%u\n", sim.resets);
+
+	return timeouts || sim.resets ? 1 : 0;
+}
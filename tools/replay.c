@@ -0,0 +1,169 @@
+/* Transcript replay against the syster card firmware                    */
+/*=======================================================================*/
+/*                                                                       */
+/* This program is free software: you can redistribute it and/or modify  */
+/* it under the terms of the GNU General Public License as published by  */
+/* the Free Software Foundation, either version 3 of the License, or     */
+/* (at your option) any later version.                                   */
+/*                                                                       */
+/* This program is distributed in the hope that it will be useful,       */
+/* but WITHOUT ANY WARRANTY; without even the implied warranty of        */
+/* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         */
+/* GNU General Public License for more details.                          */
+/*                                                                       */
+/* You should have received a copy of the GNU General Public License     */
+/* along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+
+/* Usage: replay [-c] [-m mcu] [-f f_cpu] [-b baud] transcript elf
+ *        replay -p transcript
+ *
+ * Decoder frames are sent at their recorded offsets (or, with -c, as soon
+ * as the card has answered the previous one); card frames are awaited and
+ * compared. Output is tab separated:
+ *
+ *   summary  <sent> <received> <mismatches> <timeouts> <cycles> <usec>
+ *   latency  <who> <min> <p50> <p99> <max>     usec, frame start to reply start
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "simcard.h"
+#include "transcript.h"
+
+#define REPLAY_TIMEOUT 4000000
+#define REPLAY_GAP     5
+
+static simcard_t sim;
+
+static int _cmp(const void *a, const void *b)
+{
+	double x = *(const double *) a, y = *(const double *) b;
+
+	return x < y ? -1 : x > y;
+}
+
+static void _latency(const char *who, double *v, int n)
+{
+	if(n == 0)
+		return;
+	qsort(v, n, sizeof(double), _cmp);
+	printf("latency\t%s\t%.1f\t%.1f\t%.1f\t%.1f\n", who, v[0], v[n / 2], v[(n * 99) / 100], v[n - 1]);
+}
+
+static int _print(const char *file)
+{
+	transcript_t t;
+	tr_record_t r;
+
+	if(tr_open(&t, file) < 0)
+	{
+		fprintf(stderr, "replay: %s is not a transcript\n", file);
+		return 1;
+	}
+	printf("# %s\tclock=%u\tetu=%u\n", file, t.clock, t.etu);
+	while(tr_read(&t, &r) == 0)
+		printf("%llu\t%s\t%03X\n", (unsigned long long) r.at, r.dir == TR_FROM_CARD ? "card" : "dec", r.frame);
+	tr_close(&t);
+
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	const char *mcu = NULL;
+	uint32_t freq = SIM_F_CPU, baud = SIM_BAUDRATE;
+	int opt, compress = 0, print = 0;
+	int sent = 0, received = 0, mismatches = 0, timeouts = 0, nlat = 0, max = 0;
+	double *lat = NULL, *reclat = NULL, scale;
+	uint64_t rec_sent = 0;
+	avr_cycle_count_t base, last_sent = 0;
+	transcript_t t;
+	tr_record_t r;
+	uint16_t c;
+
+	while((opt = getopt(argc, argv, "cpm:f:b:")) != -1)
+	{
+		switch(opt)
+		{
+		case 'c': compress = 1; break;
+		case 'p': print = 1; break;
+		case 'm': mcu = optarg; break;
+		case 'f': freq = strtoul(optarg, NULL, 0); break;
+		case 'b': baud = strtoul(optarg, NULL, 0); break;
+		default:
+			fprintf(stderr, "usage: %s [-c] [-m mcu] [-f f_cpu] [-b baud] transcript elf\n", argv[0]);
+			return 2;
+		}
+	}
+	if(print && optind < argc)
+		return _print(argv[optind]);
+	if(optind + 2 > argc)
+	{
+		fprintf(stderr, "%s: need a transcript and a firmware\n", argv[0]);
+		return 2;
+	}
+
+	if(tr_open(&t, argv[optind]) < 0)
+	{
+		fprintf(stderr, "replay: %s is not a transcript\n", argv[optind]);
+		return 1;
+	}
+	if(simcard_open(&sim, argv[optind + 1], mcu, freq, baud) < 0)
+		return 1;
+
+	scale = (double) sim.freq / t.clock;
+	simcard_run_until(&sim, 20 * sim.etu);
+	base = sim.avr->cycle;
+
+	while(tr_read(&t, &r) == 0)
+	{
+		if(r.dir == TR_TO_CARD)
+		{
+			if(!compress)
+				simcard_run_until(&sim, base + (avr_cycle_count_t) (r.at * scale));
+			last_sent = sim.avr->cycle;
+			rec_sent = r.at;
+			if(simcard_send(&sim, r.frame) < 0)
+				break;
+			sent++;
+			continue;
+		}
+
+		if(simcard_recv(&sim, &c, REPLAY_TIMEOUT) < 0)
+		{
+			timeouts++;
+			continue;
+		}
+		received++;
+		if(c != r.frame)
+			mismatches++;
+
+		if(nlat == max)
+		{
+			max = max ? max * 2 : 1024;
+			lat = realloc(lat, max * sizeof(double));
+			reclat = realloc(reclat, max * sizeof(double));
+		}
+		lat[nlat] = (double) (sim.recv_at - last_sent) * 1000000.0 / sim.freq;
+		reclat[nlat] = (double) (r.at - rec_sent) * 1000000.0 / t.clock;
+		nlat++;
+
+		if(compress)
+			simcard_run_until(&sim, sim.avr->cycle + REPLAY_GAP * sim.etu);
+	}
+	tr_close(&t);
+
+	printf("# replay\t%s\t%s\tmode=%s\n", argv[optind], argv[optind + 1], compress ? "compressed" : "original");
+	printf("summary\t%d\t%d\t%d\t%d\t%llu\t%.1f\n", sent, received, mismatches, timeouts,
+		(unsigned long long) (sim.avr->cycle - base), (double) (sim.avr->cycle - base) * 1000000.0 / sim.freq);
+	_latency("card", lat, nlat);
+	_latency("recorded", reclat, nlat);
+
+	free(lat);
+	free(reclat);
+
+	return (mismatches || timeouts) ? 1 : 0;
+}
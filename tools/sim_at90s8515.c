@@ -0,0 +1,165 @@
+/* AT90S8515 core for simavr, used by the card harness                   */
+/*=======================================================================*/
+/*                                                                       */
+/* This program is free software: you can redistribute it and/or modify  */
+/* it under the terms of the GNU General Public License as published by  */
+/* the Free Software Foundation, either version 3 of the License, or     */
+/* (at your option) any later version.                                   */
+/*                                                                       */
+/* This program is distributed in the hope that it will be useful,       */
+/* but WITHOUT ANY WARRANTY; without even the implied warranty of        */
+/* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         */
+/* GNU General Public License for more details.                          */
+/*                                                                       */
+/* You should have received a copy of the GNU General Public License     */
+/* along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+
+/* simavr ships no AT90S8515 core, so the harness brings its own. Only
+ * what the firmware touches is modelled: ports A-D, Timer0 as a plain
+ * 8-bit counter, Timer1 in normal and CTC mode with both compare units
+ * and input capture, the EEPROM and the watchdog. PWM, the UART, SPI
+ * and the analog comparator are left out.
+ *
+ * The AT90S8515 has no reset flags and no EEPROM or watchdog interrupt;
+ * a watchdog timeout simply resets the core.
+ *
+ * Register addresses and vectors come from avr-libc's <avr/io8515.h>, read
+ * the way simavr's own cores read them: as assembler constants, data
+ * space addresses instead of pointers.
+ */
+
+#include <simavr/sim_avr.h>
+#include <simavr/avr_eeprom.h>
+#include <simavr/avr_watchdog.h>
+#include <simavr/avr_ioport.h>
+#include <simavr/avr_timer.h>
+
+#include "simcard.h"
+
+#define __ASSEMBLER__
+#define _AVR_IO_H_
+#include <avr/sfr_defs.h>
+#include <avr/io8515.h>
+#undef _VECTOR
+#define _VECTOR(N) (N)
+
+static void _init(avr_t *avr);
+
+static struct mcu_t
+{
+	avr_t core;
+	avr_eeprom_t eeprom;
+	avr_watchdog_t watchdog;
+	avr_ioport_t porta, portb, portc, portd;
+	avr_timer_t timer0, timer1;
+} _mcu = {
+	.core = {
+		.mmcu = "at90s8515",
+		.ramend = RAMEND,
+		.flashend = FLASHEND,
+		.e2end = E2END,
+		.vector_size = 2,
+		.init = _init,
+	},
+	.eeprom = {
+		.size = E2END + 1,
+		.r_eearh = EEARH,
+		.r_eearl = EEARL,
+		.r_eedr = EEDR,
+		.r_eecr = EECR,
+		.eempe = AVR_IO_REGBIT(EECR, EEMWE),
+		.eepe = AVR_IO_REGBIT(EECR, EEWE),
+		.eere = AVR_IO_REGBIT(EECR, EERE),
+	},
+	.watchdog = {
+		.wdce = AVR_IO_REGBIT(WDTCR, WDTOE),
+		.wde = AVR_IO_REGBIT(WDTCR, WDE),
+		.wdp = { AVR_IO_REGBIT(WDTCR, WDP0), AVR_IO_REGBIT(WDTCR, WDP1), AVR_IO_REGBIT(WDTCR, WDP2) },
+	},
+	.porta = { .name = 'A', .r_port = PORTA, .r_ddr = DDRA, .r_pin = PINA },
+	.portb = { .name = 'B', .r_port = PORTB, .r_ddr = DDRB, .r_pin = PINB },
+	.portc = { .name = 'C', .r_port = PORTC, .r_ddr = DDRC, .r_pin = PINC },
+	.portd = { .name = 'D', .r_port = PORTD, .r_ddr = DDRD, .r_pin = PIND },
+	.timer0 = {
+		.name = '0',
+		.wgm_op = { [0] = AVR_TIMER_WGM_NORMAL8() },
+		.cs = { AVR_IO_REGBIT(TCCR0, CS00), AVR_IO_REGBIT(TCCR0, CS01), AVR_IO_REGBIT(TCCR0, CS02) },
+		.cs_div = { 0, 0, 3 /* 8 */, 6 /* 64 */, 8 /* 256 */, 10 /* 1024 */ },
+		.r_tcnt = TCNT0,
+		.overflow = {
+			.enable = AVR_IO_REGBIT(TIMSK, TOIE0),
+			.raised = AVR_IO_REGBIT(TIFR, TOV0),
+			.vector = TIMER0_OVF_vect,
+		},
+	},
+	.timer1 = {
+		.name = '1',
+		/* PWM10, PWM11 and CTC1 line up with WGM10, WGM11 and WGM12 */
+		.wgm = { AVR_IO_REGBIT(TCCR1A, PWM10), AVR_IO_REGBIT(TCCR1A, PWM11), AVR_IO_REGBIT(TCCR1B, CTC1) },
+		.wgm_op = {
+			[0] = AVR_TIMER_WGM_NORMAL16(),
+			[4] = AVR_TIMER_WGM_CTC(),
+		},
+		.cs = { AVR_IO_REGBIT(TCCR1B, CS10), AVR_IO_REGBIT(TCCR1B, CS11), AVR_IO_REGBIT(TCCR1B, CS12) },
+		.cs_div = { 0, 0, 3 /* 8 */, 6 /* 64 */, 8 /* 256 */, 10 /* 1024 */ },
+		.r_tcnt = TCNT1L,
+		.r_tcnth = TCNT1H,
+		.r_icr = ICR1L,
+		.r_icrh = ICR1H,
+		.ices = AVR_IO_REGBIT(TCCR1B, ICES1),
+		.overflow = {
+			.enable = AVR_IO_REGBIT(TIMSK, TOIE1),
+			.raised = AVR_IO_REGBIT(TIFR, TOV1),
+			.vector = TIMER1_OVF_vect,
+		},
+		.icr = {
+			.enable = AVR_IO_REGBIT(TIMSK, TICIE1),
+			.raised = AVR_IO_REGBIT(TIFR, ICF1),
+			.vector = TIMER1_CAPT_vect,
+		},
+		.comp = {
+			[AVR_TIMER_COMPA] = {
+				.r_ocr = OCR1AL,
+				.r_ocrh = OCR1AH,
+				.interrupt = {
+					.enable = AVR_IO_REGBIT(TIMSK, OCIE1A),
+					.raised = AVR_IO_REGBIT(TIFR, OCF1A),
+					.vector = TIMER1_COMPA_vect,
+				},
+			},
+			[AVR_TIMER_COMPB] = {
+				.r_ocr = OCR1BL,
+				.r_ocrh = OCR1BH,
+				.interrupt = {
+					.enable = AVR_IO_REGBIT(TIMSK, OCIE1B),
+					.raised = AVR_IO_REGBIT(TIFR, OCF1B),
+					.vector = TIMER1_COMPB_vect,
+				},
+			},
+		},
+	},
+};
+
+static void _init(avr_t *avr)
+{
+	struct mcu_t *mcu = (struct mcu_t *) avr;
+
+	avr_eeprom_init(avr, &mcu->eeprom);
+	avr_watchdog_init(avr, &mcu->watchdog);
+	avr_ioport_init(avr, &mcu->porta);
+	avr_ioport_init(avr, &mcu->portb);
+	avr_ioport_init(avr, &mcu->portc);
+	avr_ioport_init(avr, &mcu->portd);
+	avr_timer_init(avr, &mcu->timer0);
+	avr_timer_init(avr, &mcu->timer1);
+}
+
+static avr_t *_make(void)
+{
+	return avr_core_allocate(&_mcu.core, sizeof(_mcu));
+}
+
+avr_kind_t simcard_at90s8515 = {
+	.names = { "at90s8515" },
+	.make = _make,
+};
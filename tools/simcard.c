@@ -0,0 +1,348 @@
+/* Host-side simavr harness for the syster card firmware                 */
+/*=======================================================================*/
+/*                                                                       */
+/* This program is free software: you can redistribute it and/or modify  */
+/* it under the terms of the GNU General Public License as published by  */
+/* the Free Software Foundation, either version 3 of the License, or     */
+/* (at your option) any later version.                                   */
+/*                                                                       */
+/* This program is distributed in the hope that it will be useful,       */
+/* but WITHOUT ANY WARRANTY; without even the implied warranty of        */
+/* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         */
+/* GNU General Public License for more details.                          */
+/*                                                                       */
+/* You should have received a copy of the GNU General Public License     */
+/* along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <simavr/sim_avr.h>
+#include <simavr/sim_elf.h>
+#include <simavr/avr_ioport.h>
+#include <simavr/avr_timer.h>
+
+#include "simcard.h"
+
+#define SIM_PIN 6
+
+static avr_kind_t *_cores[] = { &simcard_at90s8515, &simcard_atmega163 };
+
+/* A card frame 0x11D right after the pair 15 1D accepts the PPS request,
+ * the decoder side follows the card to ETU / 2^(D-1) like a real decoder.
+ */
+static void _pps(simcard_t *s, uint16_t frame)
+{
+	int di = s->tx_last[1] & 0x0F;
+
+	if(s->tx_last[0] != 0x115 || (s->tx_last[1] & 0xF0) != 0x10)
+		return;
+	if(di < 1 || di > 4)
+		return;
+	s->tx_last[0] = 0;
+	simcard_set_etu(s, frame == (0x100 | s->tx_last[1]) ? s->etu_base >> (di - 1) : s->etu_base);
+}
+
+/* Work out the level on the wire: the card drives it while PB6 is an
+ * output, otherwise the decoder side (idle high) does. Every change is
+ * forwarded to ICP, exactly like the hardware where PB6 and ICP are tied.
+ */
+static void _line_update(simcard_t *s)
+{
+	avr_ioport_state_t st;
+	int level, card;
+
+	avr_ioctl(s->avr, AVR_IOCTL_IOPORT_GETSTATE('B'), &st);
+	card = (st.ddr >> SIM_PIN) & 1;
+	level = card ? (st.port >> SIM_PIN) & 1 : s->dec_level;
+
+	if(level == s->line)
+		return;
+	s->line = level;
+	avr_raise_irq(s->icp_irq, level);
+
+	/* falling edge from the card while idle: start bit */
+	if(card && level == 0 && s->rx_bits < 0)
+	{
+		s->rx_bits = 0;
+		s->rx_frame = 0;
+		s->rx_start = s->avr->cycle;
+		s->rx_next = s->rx_start + s->etu / 2;
+	}
+}
+
+static void _pin_notify(struct avr_irq_t *irq, uint32_t value, void *param)
+{
+	simcard_t *s = (simcard_t *) param;
+
+	if(s->self)
+		return;
+	_line_update(s);
+}
+
+static void _drive(simcard_t *s, int level)
+{
+	s->dec_level = level;
+	s->self = 1;
+	avr_raise_irq(s->pin_irq, level);
+	s->self = 0;
+	_line_update(s);
+}
+
+static void _sample(simcard_t *s)
+{
+	int bit = s->line;
+
+	s->rx_frame |= (uint16_t) bit << s->rx_bits;
+	s->rx_bits++;
+	s->rx_next += s->etu;
+
+	if(s->rx_bits < SIM_FRAMEBITS)
+		return;
+
+	/* S.0.1.2.3.4.5.6.7.8.P */
+	if((s->rx_frame & 1) == 0 && (s->rx_frame >> 10) & 1)
+	{
+		int next = (s->rxq_head + 1) % SIM_RXQUEUE;
+
+		if(next != s->rxq_tail)
+		{
+			s->rxq[s->rxq_head] = (s->rx_frame >> 1) & 0x1FF;
+			s->rxq_at[s->rxq_head] = s->rx_start;
+			s->rxq_head = next;
+		}
+		if(s->observe)
+			s->observe(s->observe_param, SIM_DIR_FROM_CARD, (s->rx_frame >> 1) & 0x1FF, s->rx_start);
+		_pps(s, (s->rx_frame >> 1) & 0x1FF);
+	}
+	else
+	{
+		s->rx_errors++;
+	}
+	s->rx_bits = -1;
+}
+
+static void _profile_enter(simcard_t *s)
+{
+	uint32_t pc = s->avr->pc;
+	int f;
+
+	for(f = 0; f < s->nfuncs; f++)
+	{
+		if(s->func[f].addr != pc)
+			continue;
+		if(s->depth < SIM_MAXDEPTH)
+		{
+			s->stack[s->depth].f = f;
+			s->stack[s->depth].sp = s->avr->data[R_SPL] | (s->avr->data[R_SPH] << 8);
+			s->stack[s->depth].start = s->avr->cycle;
+			s->depth++;
+		}
+		s->func[f].calls++;
+		break;
+	}
+}
+
+static void _profile_leave(simcard_t *s)
+{
+	uint16_t sp = s->avr->data[R_SPL] | (s->avr->data[R_SPH] << 8);
+
+	/* a frame is left once SP climbs above the return address */
+	while(s->depth > 0 && sp > s->stack[s->depth - 1].sp)
+	{
+		s->depth--;
+		s->func[s->stack[s->depth].f].cycles += s->avr->cycle - s->stack[s->depth].start;
+	}
+}
+
+int simcard_open(simcard_t *s, const char *elf, const char *mcu, uint32_t freq, uint32_t baud)
+{
+	elf_firmware_t f;
+	unsigned int i;
+
+	memset(s, 0, sizeof(*s));
+	memset(&f, 0, sizeof(f));
+
+	if(elf_read_firmware(elf, &f) != 0)
+	{
+		fprintf(stderr, "simcard: cannot read %s\n", elf);
+		return -1;
+	}
+	if(mcu)
+		strncpy(f.mmcu, mcu, sizeof(f.mmcu) - 1);
+	f.frequency = freq;
+
+	/* our cores first, simavr proper has none for the card MCUs */
+	for(i = 0; i < sizeof(_cores) / sizeof(_cores[0]) && !s->avr; i++)
+		if(strcmp(f.mmcu, _cores[i]->names[0]) == 0)
+			s->avr = _cores[i]->make();
+	if(!s->avr)
+		s->avr = avr_make_mcu_by_name(f.mmcu);
+	if(!s->avr)
+	{
+		fprintf(stderr, "simcard: simavr has no core for '%s'\n", f.mmcu);
+		return -1;
+	}
+	avr_init(s->avr);
+	avr_load_firmware(s->avr, &f);
+
+	s->freq = freq;
+	s->etu = freq / baud;
+	s->etu_base = s->etu;
+	s->rx_bits = -1;
+	s->line = 1;
+	s->dec_level = 1;
+
+	s->pin_irq = avr_io_getirq(s->avr, AVR_IOCTL_IOPORT_GETIRQ('B'), IOPORT_IRQ_PIN0 + SIM_PIN);
+	s->icp_irq = avr_io_getirq(s->avr, AVR_IOCTL_TIMER_GETIRQ('1'), TIMER_IRQ_IN_ICP);
+	if(!s->pin_irq || !s->icp_irq)
+	{
+		fprintf(stderr, "simcard: %s lacks PB6 or ICP1\n", f.mmcu);
+		return -1;
+	}
+	avr_irq_register_notify(s->pin_irq, _pin_notify, s);
+	avr_irq_register_notify(avr_io_getirq(s->avr, AVR_IOCTL_IOPORT_GETIRQ('B'), IOPORT_IRQ_DIRECTION_ALL), _pin_notify, s);
+	_drive(s, 1);
+
+	return 0;
+}
+
+/* Symbols come from `avr-nm -S --defined-only`: addr size type name */
+int simcard_load_symbols(simcard_t *s, const char *symfile)
+{
+	FILE *fp;
+	char line[256], type, name[128];
+	unsigned long addr, size;
+
+	fp = fopen(symfile, "r");
+	if(!fp)
+	{
+		fprintf(stderr, "simcard: cannot read %s\n", symfile);
+		return -1;
+	}
+	while(fgets(line, sizeof(line), fp) && s->nfuncs < SIM_MAXFUNCS)
+	{
+		if(sscanf(line, "%lx %lx %c %127s", &addr, &size, &type, name) != 4)
+			continue;
+		if(type != 'T' && type != 't')
+			continue;
+		strncpy(s->func[s->nfuncs].name, name, sizeof(s->func[0].name) - 1);
+		s->func[s->nfuncs].addr = addr;
+		s->func[s->nfuncs].size = size;
+		s->nfuncs++;
+	}
+	fclose(fp);
+
+	return s->nfuncs;
+}
+
+int simcard_step(simcard_t *s)
+{
+	int state;
+
+	if(s->nfuncs)
+		_profile_enter(s);
+
+	state = avr_run(s->avr);
+	if(state == cpu_Done || state == cpu_Crashed)
+		return -1;
+	/* avr_reset() leaves the PC on the reset vector until the next run */
+	if(s->avr->pc == 0)
+		s->resets++;
+
+	if(s->nfuncs)
+		_profile_leave(s);
+
+	/* decoder transmitter */
+	if(s->tx_bits > 0 && s->avr->cycle >= s->tx_next)
+	{
+		int bit = s->tx_frame & 1;
+
+		s->tx_frame >>= 1;
+		s->tx_bits--;
+		s->tx_next += s->etu;
+		_drive(s, bit);
+	}
+
+	/* decoder receiver */
+	if(s->rx_bits >= 0 && s->avr->cycle >= s->rx_next)
+		_sample(s);
+
+	return 0;
+}
+
+int simcard_run_until(simcard_t *s, avr_cycle_count_t cycle)
+{
+	while(s->avr->cycle < cycle)
+		if(simcard_step(s) < 0)
+			return -1;
+	return 0;
+}
+
+int simcard_send(simcard_t *s, uint16_t c)
+{
+	while(s->tx_bits > 0)
+		if(simcard_step(s) < 0)
+			return -1;
+
+	/* frame = G.P.8.7.6.5.4.3.2.1.0.S   S=Start(0), P=Stop(1), G=Guard(1) */
+	s->tx_frame = (3 << 10) | ((c & 0x1FF) << 1);
+	s->tx_bits = SIM_FRAMEBITS + 1;
+	s->tx_next = s->avr->cycle;
+	s->tx_last[0] = s->tx_last[1];
+	s->tx_last[1] = c & 0x1FF;
+	if(s->observe)
+		s->observe(s->observe_param, SIM_DIR_TO_CARD, c & 0x1FF, s->avr->cycle);
+
+	while(s->tx_bits > 0)
+		if(simcard_step(s) < 0)
+			return -1;
+	return 0;
+}
+
+int simcard_recv(simcard_t *s, uint16_t *c, avr_cycle_count_t timeout)
+{
+	avr_cycle_count_t end = s->avr->cycle + timeout;
+
+	while(s->rxq_head == s->rxq_tail)
+	{
+		if(s->avr->cycle >= end)
+			return -1;
+		if(simcard_step(s) < 0)
+			return -1;
+	}
+	*c = s->rxq[s->rxq_tail];
+	s->recv_at = s->rxq_at[s->rxq_tail];
+	s->rxq_tail = (s->rxq_tail + 1) % SIM_RXQUEUE;
+
+	return 0;
+}
+
+void simcard_set_etu(simcard_t *s, uint32_t etu)
+{
+	s->etu = etu;
+}
+
+void simcard_reset_profile(simcard_t *s)
+{
+	int f;
+
+	for(f = 0; f < s->nfuncs; f++)
+	{
+		s->func[f].calls = 0;
+		s->func[f].cycles = 0;
+	}
+	for(f = 0; f < s->depth; f++)
+		s->stack[f].start = s->avr->cycle;
+}
+
+int simcard_find_func(simcard_t *s, const char *name)
+{
+	int f;
+
+	for(f = 0; f < s->nfuncs; f++)
+		if(strcmp(s->func[f].name, name) == 0)
+			return f;
+	return -1;
+}
@@ -0,0 +1,107 @@
+/* Host-side simavr harness for the syster card firmware                 */
+/*=======================================================================*/
+/*                                                                       */
+/* This program is free software: you can redistribute it and/or modify  */
+/* it under the terms of the GNU General Public License as published by  */
+/* the Free Software Foundation, either version 3 of the License, or     */
+/* (at your option) any later version.                                   */
+/*                                                                       */
+/* This program is distributed in the hope that it will be useful,       */
+/* but WITHOUT ANY WARRANTY; without even the implied warranty of        */
+/* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         */
+/* GNU General Public License for more details.                          */
+/*                                                                       */
+/* You should have received a copy of the GNU General Public License     */
+/* along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+
+/* The simulated card is wired like the real one: PB6 carries the 9-bit
+ * half-duplex line and is also fed to the Timer1 input capture. The
+ * harness plays the decoder side of that line, bit by bit, in simulated
+ * cycles, so the firmware runs unmodified.
+ */
+
+#ifndef _SIMCARD_H_
+#define _SIMCARD_H_
+
+#include <stdint.h>
+#include <simavr/sim_avr.h>
+
+#define SIM_F_CPU    (26625000UL / 7)
+#define SIM_BAUDRATE 9453
+#define SIM_FRAMEBITS 11            /* start + 9 data + stop */
+
+#define SIM_MAXFUNCS 64
+#define SIM_MAXDEPTH 16
+#define SIM_RXQUEUE  64
+
+typedef struct
+{
+	char name[48];
+	uint32_t addr;                  /* byte address, as in avr->pc */
+	uint32_t size;
+	uint32_t calls;
+	avr_cycle_count_t cycles;       /* inclusive */
+} sim_func_t;
+
+typedef struct
+{
+	avr_t *avr;
+	uint32_t freq;
+	uint32_t etu;                   /* cycles per bit */
+	uint32_t etu_base;              /* at the nominal baud rate */
+
+	/* line */
+	int line;                       /* current level seen by both sides */
+	int dec_level;                  /* level driven by the decoder side */
+	int self;                       /* set while we raise the pin irq */
+	struct avr_irq_t *pin_irq;
+	struct avr_irq_t *icp_irq;
+
+	/* decoder -> card */
+	uint16_t tx_frame;
+	int tx_bits;
+	avr_cycle_count_t tx_next;
+	uint16_t tx_last[2];            /* previous pair, for PPS */
+
+	/* card -> decoder */
+	int rx_bits;
+	uint16_t rx_frame;
+	avr_cycle_count_t rx_next;
+	avr_cycle_count_t rx_start;
+	uint16_t rxq[SIM_RXQUEUE];
+	avr_cycle_count_t rxq_at[SIM_RXQUEUE];
+	int rxq_head, rxq_tail;
+	avr_cycle_count_t recv_at;      /* start of the frame simcard_recv returned */
+	uint32_t rx_errors;
+	uint32_t resets;                /* after power-on: watchdog, crash */
+
+	/* profiler */
+	sim_func_t func[SIM_MAXFUNCS];
+	int nfuncs;
+	struct { int f; uint16_t sp; avr_cycle_count_t start; } stack[SIM_MAXDEPTH];
+	int depth;
+
+	/* frame observer, see transcript.h */
+	void (*observe)(void *param, int dir, uint16_t frame, avr_cycle_count_t at);
+	void *observe_param;
+} simcard_t;
+
+#define SIM_DIR_TO_CARD   0
+#define SIM_DIR_FROM_CARD 1
+
+/* cores for the card MCUs, which simavr itself lacks */
+extern avr_kind_t simcard_at90s8515, simcard_atmega163;
+
+extern int simcard_open(simcard_t *s, const char *elf, const char *mcu, uint32_t freq, uint32_t baud);
+extern int simcard_load_symbols(simcard_t *s, const char *symfile);
+
+extern int simcard_step(simcard_t *s);
+extern int simcard_run_until(simcard_t *s, avr_cycle_count_t cycle);
+extern int simcard_send(simcard_t *s, uint16_t c);
+extern int simcard_recv(simcard_t *s, uint16_t *c, avr_cycle_count_t timeout);
+extern void simcard_set_etu(simcard_t *s, uint32_t etu);
+
+extern void simcard_reset_profile(simcard_t *s);
+extern int simcard_find_func(simcard_t *s, const char *name);
+
+#endif /* _SIMCARD_H_ */
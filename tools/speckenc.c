@@ -0,0 +1,197 @@
+/* Speck64/128 ECM encoder for cryptmode 3 of the syster card firmware   */
+/*=======================================================================*/
+/*                                                                       */
+/* This program is free software: you can redistribute it and/or modify  */
+/* it under the terms of the GNU General Public License as published by  */
+/* the Free Software Foundation, either version 3 of the License, or     */
+/* (at your option) any later version.                                   */
+/*                                                                       */
+/* This program is distributed in the hope that it will be useful,       */
+/* but WITHOUT ANY WARRANTY; without even the implied warranty of        */
+/* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         */
+/* GNU General Public License for more details.                          */
+/*                                                                       */
+/* You should have received a copy of the GNU General Public License     */
+/* along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+
+/* Usage: speckenc [-k k0:k1:k2:k3] [-e] <8 bytes hex>
+ *        speckenc -t
+ *
+ * Head-end side of _rand_seed_speck() in main.c. The card encrypts the
+ * first 8 ECM bytes and answers the result as CW, after checking the
+ * state after round 8 against ECM bytes 8..15. Given the CW the channel
+ * should get, speckenc decrypts it to the ECM block and adds the
+ * signature; with -e the 8 bytes are the ECM block instead. Output:
+ *
+ *   ecm <16 bytes>        ready for tools/bench.txt after "0600"
+ *   cw <8 bytes>
+ *
+ * The key is the 4 words of _xtea_key[n] (default: the first one as
+ * flashed), k0 is the first round key. -t checks the Speck64/128 test
+ * vector.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdint.h>
+
+#define SPECK_ROUNDS 27
+#define SPECK_SIGROUND 8
+
+#define ROR(x, r) (((x) >> (r)) | ((x) << (32 - (r))))
+#define ROL(x, r) (((x) << (r)) | ((x) >> (32 - (r))))
+
+static uint32_t _rk[SPECK_ROUNDS];
+
+static void _schedule(const uint32_t key[4])
+{
+	uint32_t l[SPECK_ROUNDS + 2];
+	int i;
+
+	_rk[0] = key[0];
+	l[0] = key[1];
+	l[1] = key[2];
+	l[2] = key[3];
+	for(i = 0; i < SPECK_ROUNDS - 1; i++)
+	{
+		l[i + 3] = (_rk[i] + ROR(l[i], 8)) ^ i;
+		_rk[i + 1] = ROL(_rk[i], 3) ^ l[i + 3];
+	}
+}
+
+static void _encrypt(uint32_t *x, uint32_t *y, int rounds)
+{
+	int i;
+
+	for(i = 0; i < rounds; i++)
+	{
+		*x = (ROR(*x, 8) + *y) ^ _rk[i];
+		*y = ROL(*y, 3) ^ *x;
+	}
+}
+
+static void _decrypt(uint32_t *x, uint32_t *y)
+{
+	int i;
+
+	for(i = SPECK_ROUNDS - 1; i >= 0; i--)
+	{
+		*y = ROR(*y ^ *x, 3);
+		*x = ROL((*x ^ _rk[i]) - *y, 8);
+	}
+}
+
+static uint32_t _get32(const uint8_t *p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+static void _put32(uint8_t *p, uint32_t v)
+{
+	p[0] = v;
+	p[1] = v >> 8;
+	p[2] = v >> 16;
+	p[3] = v >> 24;
+}
+
+static void _print(const char *tag, const uint8_t *b, int n)
+{
+	int i;
+
+	printf("%s", tag);
+	for(i = 0; i < n; i++)
+		printf(" %02X", b[i]);
+	printf("\n");
+}
+
+/* Speck64/128 from the Speck paper, key 1b1a1918 13121110 0b0a0908 03020100 */
+static int _selftest(void)
+{
+	const uint32_t key[4] = {0x03020100, 0x0b0a0908, 0x13121110, 0x1b1a1918};
+	uint32_t x = 0x3b726574, y = 0x7475432d;
+
+	_schedule(key);
+	_encrypt(&x, &y, SPECK_ROUNDS);
+	if(x != 0x8c6fa548 || y != 0x454e028b)
+	{
+		printf("test\tfail\t%08x %08x\n", x, y);
+		return 1;
+	}
+	_decrypt(&x, &y);
+	if(x != 0x3b726574 || y != 0x7475432d)
+	{
+		printf("test\tfail\tdecrypt\n");
+		return 1;
+	}
+	printf("test\tok\n");
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	uint32_t key[4] = {0x00112233, 0x44556677, 0x8899AABB, 0xCCDDEEFF};
+	uint32_t x, y, sx, sy;
+	uint8_t in[8], ecm[16], cw[8];
+	int opt, i, enc = 0;
+	unsigned int v;
+
+	while((opt = getopt(argc, argv, "k:et")) != -1)
+	{
+		switch(opt)
+		{
+		case 'k':
+			if(sscanf(optarg, "%x:%x:%x:%x", &key[0], &key[1], &key[2], &key[3]) != 4)
+			{
+				fprintf(stderr, "%s: key is k0:k1:k2:k3 in hex\n", argv[0]);
+				return 2;
+			}
+			break;
+		case 'e': enc = 1; break;
+		case 't': return _selftest();
+		default:
+			fprintf(stderr, "usage: %s [-k k0:k1:k2:k3] [-e] <8 bytes hex> | -t\n", argv[0]);
+			return 2;
+		}
+	}
+	if(argc - optind != 8)
+	{
+		fprintf(stderr, "%s: need 8 bytes\n", argv[0]);
+		return 2;
+	}
+	for(i = 0; i < 8; i++)
+	{
+		if(sscanf(argv[optind + i], "%x", &v) != 1 || v > 0xFF)
+		{
+			fprintf(stderr, "%s: bad byte %s\n", argv[0], argv[optind + i]);
+			return 2;
+		}
+		in[i] = v;
+	}
+
+	_schedule(key);
+	y = _get32(&in[0]);
+	x = _get32(&in[4]);
+	if(!enc)
+		_decrypt(&x, &y);
+	_put32(&ecm[0], y);
+	_put32(&ecm[4], x);
+
+	sx = x;
+	sy = y;
+	_encrypt(&sx, &sy, SPECK_SIGROUND);
+	_put32(&ecm[8], sy);
+	_put32(&ecm[12], sx);
+
+	x = _get32(&ecm[4]);
+	y = _get32(&ecm[0]);
+	_encrypt(&x, &y, SPECK_ROUNDS);
+	_put32(&cw[0], y);
+	_put32(&cw[4], x);
+
+	_print("ecm", ecm, 16);
+	_print("cw", cw, 8);
+
+	return 0;
+}
@@ -0,0 +1,323 @@
+/* Worst-case stack depth of the syster card firmware                     */
+/*=======================================================================*/
+/*                                                                       */
+/* This program is free software: you can redistribute it and/or modify  */
+/* it under the terms of the GNU General Public License as published by  */
+/* the Free Software Foundation, either version 3 of the License, or     */
+/* (at your option) any later version.                                   */
+/*                                                                       */
+/* This program is distributed in the hope that it will be useful,       */
+/* but WITHOUT ANY WARRANTY; without even the implied warranty of        */
+/* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         */
+/* GNU General Public License for more details.                          */
+/*                                                                       */
+/* You should have received a copy of the GNU General Public License     */
+/* along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+
+/* Usage: avr-objdump -d firmware.out | stackcheck [-s symfile [-r ramend]]
+ *                                                 [-b budget] [-p pc]
+ *
+ * Reads the disassembly of the linked ELF. A function's frame is its
+ * pushes, the Y frame set up after "in r28, 0x3d" and any "rcall .+0"
+ * used to reserve stack; every call adds the return address (-p, 2
+ * bytes). Roots are main and the __vector_N interrupt handlers.
+ *
+ * Interrupts normally don't nest, so the worst case is main plus the
+ * deepest handler. If a handler's call tree executes sei (the _syster
+ * busy answer does, through io_write), any handler may land on top of
+ * it and all of them are added up instead.
+ *
+ * The budget is the SRAM the linked image leaves free: -s reads the
+ * avr-nm listing of the same ELF, the stack may grow from RAMEND (the
+ * __stack symbol, else -r) down to __heap_start, the end of .data,
+ * .bss and .noinit. -b caps it further. Output is tab separated:
+ *
+ *   sram   <__heap_start> <ramend> <free bytes>
+ *   root   <function> <bytes> <call chain>
+ *   total  <bytes> <budget> ok|over
+ *
+ * Exits 1 on recursion or when the total is over budget.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define MAXFUNCS 512
+#define MAXCALLS 4096
+#define NAMELEN  64
+
+typedef struct
+{
+	char name[NAMELEN];
+	int frame;
+	int sei;                        /* executes sei itself */
+	int indirect;                   /* icall/ijmp, not followed */
+	int framed;                     /* Y frame already counted */
+	int depth;                      /* -1 = not computed */
+	int busy;
+	int next;                       /* deepest callee */
+	int tree_sei;
+} func_t;
+
+typedef struct
+{
+	int from;
+	char to[NAMELEN];
+	int callee;
+	int tail;
+} call_t;
+
+static func_t func[MAXFUNCS];
+static call_t call[MAXCALLS];
+static int nfuncs, ncalls, pc_bytes = 2, recursion;
+
+static int _find(const char *name)
+{
+	int f;
+
+	for(f = 0; f < nfuncs; f++)
+		if(strcmp(func[f].name, name) == 0)
+			return f;
+	return -1;
+}
+
+/* "<name>" or "<name+0x12>" in an objdump comment */
+static int _target(const char *line, char *name, int *inside)
+{
+	const char *p = strrchr(line, '<'), *e;
+	size_t n;
+
+	if(!p)
+		return -1;
+	p++;
+	e = strpbrk(p, "+>");
+	if(!e)
+		return -1;
+	n = e - p < NAMELEN - 1 ? e - p : NAMELEN - 1;
+	memcpy(name, p, n);
+	name[n] = 0;
+	*inside = *e == '+';
+	return 0;
+}
+
+/* avr-nm: "00800160 00000002 B name" or "0000025f W __stack" */
+static int _sram(const char *file, unsigned int *heap, unsigned int *ramend)
+{
+	char line[256], name[NAMELEN];
+	unsigned int addr, size;
+	char type;
+	FILE *fp = fopen(file, "r");
+
+	if(!fp)
+		return -1;
+	*heap = 0;
+	while(fgets(line, sizeof(line), fp))
+	{
+		if(sscanf(line, "%x %x %c %63s", &addr, &size, &type, name) != 4 &&
+		   sscanf(line, "%x %c %63s", &addr, &type, name) != 3)
+			continue;
+		if(strcmp(name, "__heap_start") == 0)
+			*heap = addr & 0xFFFF;
+		else if(strcmp(name, "__stack") == 0)
+			*ramend = addr & 0xFFFF;
+	}
+	fclose(fp);
+
+	return *heap ? 0 : -1;
+}
+
+static void _parse(FILE *fp)
+{
+	char line[512], mn[16], op[64], name[NAMELEN];
+	int cur = -1, inside, yframe = 0;
+	unsigned int addr, v;
+
+	while(fgets(line, sizeof(line), fp))
+	{
+		if(sscanf(line, "%x <%63[^>]>:", &addr, name) == 2)
+		{
+			if(nfuncs == MAXFUNCS)
+				break;
+			cur = nfuncs++;
+			memset(&func[cur], 0, sizeof(func_t));
+			strcpy(func[cur].name, name);
+			func[cur].depth = -1;
+			yframe = 0;
+			continue;
+		}
+		if(cur < 0 || !strchr(line, '\t'))
+			continue;
+
+		/* "  a4:\tde df       \trcall\t.-68     \t; 0x62 <bar>" */
+		{
+			char *t = strchr(line, '\t');
+			t = t ? strchr(t + 1, '\t') : NULL;
+			if(!t)
+				continue;
+			mn[0] = op[0] = 0;
+			sscanf(t + 1, "%15s %63[^;\n]", mn, op);
+		}
+
+		if(strcmp(mn, "push") == 0)
+			func[cur].frame++;
+		else if(strcmp(mn, "sei") == 0)
+			func[cur].sei = 1;
+		else if(strcmp(mn, "icall") == 0 || strcmp(mn, "ijmp") == 0 ||
+			strcmp(mn, "eicall") == 0 || strcmp(mn, "eijmp") == 0)
+			func[cur].indirect = 1;
+		else if(strcmp(mn, "in") == 0 && strncmp(op, "r28, 0x3d", 9) == 0)
+			yframe = 1;
+		else if(yframe && !func[cur].framed &&
+			(strcmp(mn, "sbiw") == 0 || strcmp(mn, "subi") == 0) &&
+			sscanf(op, "r28, 0x%x", &v) == 1)
+		{
+			func[cur].frame += v;
+			func[cur].framed = 1;
+		}
+		else if(strcmp(mn, "out") == 0 && strncmp(op, "0x3d", 4) == 0)
+			yframe = 0;
+		else if(strcmp(mn, "rcall") == 0 || strcmp(mn, "call") == 0 ||
+			strcmp(mn, "rjmp") == 0 || strcmp(mn, "jmp") == 0)
+		{
+			int jump = mn[strlen(mn) - 3] == 'j';
+
+			if(_target(line, name, &inside) < 0)
+				continue;
+			if(strcmp(name, func[cur].name) == 0 && inside)
+			{
+				/* rcall .+0 reserves stack, jumps stay inside */
+				if(!jump)
+					func[cur].frame += pc_bytes;
+				continue;
+			}
+			if(inside || ncalls == MAXCALLS)
+				continue;
+			call[ncalls].from = cur;
+			strcpy(call[ncalls].to, name);
+			call[ncalls].tail = jump;
+			ncalls++;
+		}
+	}
+}
+
+static int _depth(int f)
+{
+	int c, d;
+
+	if(func[f].depth >= 0)
+		return func[f].depth;
+	if(func[f].busy)
+	{
+		fprintf(stderr, "stackcheck: recursion through %s\n", func[f].name);
+		recursion = 1;
+		return 0;
+	}
+	func[f].busy = 1;
+	func[f].next = -1;
+	func[f].tree_sei = func[f].sei;
+
+	d = 0;
+	for(c = 0; c < ncalls; c++)
+	{
+		int n;
+
+		if(call[c].from != f || call[c].callee < 0)
+			continue;
+		n = _depth(call[c].callee) + (call[c].tail ? 0 : pc_bytes);
+		func[f].tree_sei |= func[call[c].callee].tree_sei;
+		if(n > d)
+		{
+			d = n;
+			func[f].next = call[c].callee;
+		}
+	}
+	if(func[f].indirect)
+		fprintf(stderr, "stackcheck: indirect call in %s not followed\n", func[f].name);
+
+	func[f].busy = 0;
+	func[f].depth = func[f].frame + d;
+	return func[f].depth;
+}
+
+static void _root(int f, int extra)
+{
+	int n;
+
+	printf("root\t%s\t%d\t", func[f].name, func[f].depth + extra);
+	for(n = f; n >= 0; n = func[n].next)
+		printf("%s%s", n == f ? "" : " > ", func[n].name);
+	printf("\n");
+}
+
+int main(int argc, char *argv[])
+{
+	int opt, budget = 0, c, f, m, isr_max = 0, isr_sum = 0, nest = 0, total;
+	const char *symfile = NULL;
+	unsigned int heap, ramend = 0;
+
+	while((opt = getopt(argc, argv, "b:p:s:r:")) != -1)
+	{
+		switch(opt)
+		{
+		case 'b': budget = atoi(optarg); break;
+		case 'p': pc_bytes = atoi(optarg); break;
+		case 's': symfile = optarg; break;
+		case 'r': ramend = strtoul(optarg, NULL, 0); break;
+		default:
+			fprintf(stderr, "usage: avr-objdump -d elf | %s [-s symfile [-r ramend]] [-b budget] [-p pc]\n", argv[0]);
+			return 2;
+		}
+	}
+
+	if(symfile)
+	{
+		if(_sram(symfile, &heap, &ramend) < 0)
+		{
+			fprintf(stderr, "stackcheck: no __heap_start in %s\n", symfile);
+			return 2;
+		}
+		if(ramend < heap)
+		{
+			fprintf(stderr, "stackcheck: no RAMEND, give -r\n");
+			return 2;
+		}
+		printf("sram\t0x%04X\t0x%04X\t%u\n", heap, ramend, ramend + 1 - heap);
+		if(!budget || (int) (ramend + 1 - heap) < budget)
+			budget = ramend + 1 - heap;
+	}
+
+	_parse(stdin);
+	for(c = 0; c < ncalls; c++)
+		call[c].callee = _find(call[c].to);
+
+	m = _find("main");
+	if(m < 0)
+	{
+		fprintf(stderr, "stackcheck: no main in the disassembly\n");
+		return 2;
+	}
+	_depth(m);
+	_root(m, 0);
+
+	/* handlers are entered with the return address already pushed */
+	for(f = 0; f < nfuncs; f++)
+	{
+		if(strncmp(func[f].name, "__vector_", 9) != 0)
+			continue;
+		_depth(f);
+		_root(f, pc_bytes);
+		isr_sum += func[f].depth + pc_bytes;
+		if(func[f].depth + pc_bytes > isr_max)
+			isr_max = func[f].depth + pc_bytes;
+		nest |= func[f].tree_sei;
+	}
+
+	total = func[m].depth + (nest ? isr_sum : isr_max);
+	printf("total\t%d\t%d\t%s\n", total, budget, budget && total > budget ? "over" : "ok");
+	if(nest)
+		printf("# a handler re-enables interrupts, all handlers counted\n");
+
+	return recursion || (budget && total > budget) ? 1 : 0;
+}
@@ -0,0 +1,145 @@
+/* Decoder<->card transcript files                                       */
+/*=======================================================================*/
+/*                                                                       */
+/* This program is free software: you can redistribute it and/or modify  */
+/* it under the terms of the GNU General Public License as published by  */
+/* the Free Software Foundation, either version 3 of the License, or     */
+/* (at your option) any later version.                                   */
+/*                                                                       */
+/* This program is distributed in the hope that it will be useful,       */
+/* but WITHOUT ANY WARRANTY; without even the implied warranty of        */
+/* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         */
+/* GNU General Public License for more details.                          */
+/*                                                                       */
+/* You should have received a copy of the GNU General Public License     */
+/* along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+
+#include <string.h>
+
+#include "transcript.h"
+
+static void _put16(uint8_t *p, uint16_t v)
+{
+	p[0] = v & 0xFF;
+	p[1] = v >> 8;
+}
+
+static void _put32(uint8_t *p, uint32_t v)
+{
+	_put16(p, v & 0xFFFF);
+	_put16(p + 2, v >> 16);
+}
+
+static uint32_t _get32(const uint8_t *p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+int tr_create(transcript_t *t, const char *file, uint32_t clock, uint32_t etu)
+{
+	uint8_t h[16];
+
+	memset(t, 0, sizeof(*t));
+	t->fp = fopen(file, "wb");
+	if(!t->fp)
+		return -1;
+	t->clock = clock;
+	t->etu = etu;
+	t->first = 1;
+
+	memcpy(h, TR_MAGIC, 4);
+	h[4] = TR_VERSION;
+	h[5] = 0;
+	_put16(h + 6, 0);
+	_put32(h + 8, clock);
+	_put32(h + 12, etu);
+
+	return fwrite(h, sizeof(h), 1, t->fp) == 1 ? 0 : -1;
+}
+
+int tr_open(transcript_t *t, const char *file)
+{
+	uint8_t h[16];
+
+	memset(t, 0, sizeof(*t));
+	t->fp = fopen(file, "rb");
+	if(!t->fp)
+		return -1;
+	if(fread(h, sizeof(h), 1, t->fp) != 1 || memcmp(h, TR_MAGIC, 4) != 0 || h[4] != TR_VERSION)
+	{
+		fclose(t->fp);
+		t->fp = NULL;
+		return -1;
+	}
+	t->clock = _get32(h + 8);
+	t->etu = _get32(h + 12);
+
+	return 0;
+}
+
+int tr_write(transcript_t *t, int dir, uint16_t frame, uint64_t at)
+{
+	uint8_t b[12];
+	uint64_t delta;
+	int n = 0;
+
+	if(t->first)
+	{
+		t->last = at;
+		t->first = 0;
+	}
+	delta = at - t->last;
+	t->last = at;
+
+	do
+	{
+		b[n] = delta & 0x7F;
+		delta >>= 7;
+		if(delta)
+			b[n] |= 0x80;
+		n++;
+	} while(delta);
+
+	_put16(b + n, (frame & 0x1FF) | (dir ? 0x8000 : 0));
+	n += 2;
+
+	return fwrite(b, n, 1, t->fp) == 1 ? 0 : -1;
+}
+
+int tr_read(transcript_t *t, tr_record_t *r)
+{
+	uint64_t delta = 0;
+	int c, shift = 0;
+	uint8_t w[2];
+
+	do
+	{
+		c = fgetc(t->fp);
+		if(c == EOF || shift > 63)
+			return -1;
+		delta |= (uint64_t) (c & 0x7F) << shift;
+		shift += 7;
+	} while(c & 0x80);
+
+	if(fread(w, 2, 1, t->fp) != 1)
+		return -1;
+
+	t->last += delta;
+	r->at = t->last;
+	r->frame = (w[0] | (w[1] << 8)) & 0x1FF;
+	r->dir = w[1] & 0x80 ? TR_FROM_CARD : TR_TO_CARD;
+
+	return 0;
+}
+
+void tr_close(transcript_t *t)
+{
+	if(t->fp)
+		fclose(t->fp);
+	t->fp = NULL;
+}
+
+void tr_observe(void *param, int dir, uint16_t frame, uint64_t at)
+{
+	tr_write((transcript_t *) param, dir, frame, at);
+}
@@ -0,0 +1,66 @@
+/* Decoder<->card transcript files                                       */
+/*=======================================================================*/
+/*                                                                       */
+/* This program is free software: you can redistribute it and/or modify  */
+/* it under the terms of the GNU General Public License as published by  */
+/* the Free Software Foundation, either version 3 of the License, or     */
+/* (at your option) any later version.                                   */
+/*                                                                       */
+/* This program is distributed in the hope that it will be useful,       */
+/* but WITHOUT ANY WARRANTY; without even the implied warranty of        */
+/* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         */
+/* GNU General Public License for more details.                          */
+/*                                                                       */
+/* You should have received a copy of the GNU General Public License     */
+/* along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+
+/* File layout, all integers little endian:
+ *
+ *   header   "SYTR" u8 version u8 reserved u16 flags u32 clock u32 etu
+ *   record   varint delta, u16 word
+ *
+ * clock is the tick rate of the timestamps in Hz (F_CPU for simulator
+ * captures, the sampling rate for sniffed sessions), etu the bit time in
+ * ticks. delta is the distance in ticks to the previous record's frame
+ * start (LEB128, 7 bits per byte). word holds the 9-bit frame in bits
+ * 0..8 and the direction in bit 15 (1 = sent by the card).
+ */
+
+#ifndef _TRANSCRIPT_H_
+#define _TRANSCRIPT_H_
+
+#include <stdio.h>
+#include <stdint.h>
+
+#define TR_MAGIC   "SYTR"
+#define TR_VERSION 1
+
+#define TR_TO_CARD   0
+#define TR_FROM_CARD 1
+
+typedef struct
+{
+	FILE *fp;
+	uint32_t clock;
+	uint32_t etu;
+	uint64_t last;                  /* absolute tick of the previous record */
+	int first;
+} transcript_t;
+
+typedef struct
+{
+	uint64_t at;                    /* absolute tick since the first record */
+	uint16_t frame;
+	uint8_t dir;
+} tr_record_t;
+
+extern int tr_create(transcript_t *t, const char *file, uint32_t clock, uint32_t etu);
+extern int tr_open(transcript_t *t, const char *file);
+extern int tr_write(transcript_t *t, int dir, uint16_t frame, uint64_t at);
+extern int tr_read(transcript_t *t, tr_record_t *r);
+extern void tr_close(transcript_t *t);
+
+/* simcard_t observer: param is the transcript_t */
+extern void tr_observe(void *param, int dir, uint16_t frame, uint64_t at);
+
+#endif /* _TRANSCRIPT_H_ */
@@ -0,0 +1,79 @@
+#!/bin/sh
+# Flash/SRAM/cycles table of the variant builds, see `make variants`.
+#
+# Usage: tools/variants.sh project build/<mcu>-<variant>...
+#
+# One tab separated row per variant: flash is .text + .data, SRAM
+# .data + .bss + .noinit, both also as percent of the MCU. The sizes are
+# the output section lines of the linker map, <project>.map, the one
+# file every variant directory is sure to have next to its ELF. The remaining columns are the cycles of every
+# command in tools/bench.txt, in script order. "-" marks a variant that
+# did not link (usually: does not fit) or could not be simulated.
+
+BENCH=${BENCH:-tools/bench}
+SCRIPT=${SCRIPT:-tools/bench.txt}
+
+project=$1
+shift
+
+printf 'mcu\tvariant\tflash\tflash%%\tsram\tsram%%'
+awk '!/^#/ && NF { printf "\t%s", $1 }' "$SCRIPT"
+printf '\n'
+
+ncmds=$(awk '!/^#/ && NF' "$SCRIPT" | wc -l)
+
+for dir in "$@"
+do
+	name=${dir##*/}
+	mcu=${name%-*}
+	variant=${name##*-}
+	elf=$dir/$project.out
+	map=$dir/$project.map
+
+	case $mcu in
+	at90s8515) flashmax=8192; srammax=512 ;;
+	atmega163) flashmax=16384; srammax=1024 ;;
+	*) flashmax=0; srammax=0 ;;
+	esac
+
+	printf '%s\t%s' "$mcu" "$variant"
+
+	if [ ! -f "$elf" ] || [ ! -f "$map" ]
+	then
+		printf '\t-\t-\t-\t-'
+		i=0
+		while [ $i -lt $ncmds ]; do printf '\t-'; i=$((i + 1)); done
+		printf '\n'
+		continue
+	fi
+
+	# ".data  0x00800060  0x12 load address ..." in column 0, input
+	# sections below it are indented
+	awk -v fm=$flashmax -v sm=$srammax '
+		function hex(s,  i, v) {
+			v = 0
+			for(i = 3; i <= length(s); i++)
+				v = v * 16 + index("0123456789abcdef", tolower(substr(s, i, 1))) - 1
+			return v
+		}
+		/^\.text[ \t]/   && NF >= 3 { t = hex($3) }
+		/^\.data[ \t]/   && NF >= 3 { d = hex($3) }
+		/^\.bss[ \t]/    && NF >= 3 { b = hex($3) }
+		/^\.noinit[ \t]/ && NF >= 3 { n = hex($3) }
+		END {
+			f = t + d; s = d + b + n
+			printf "\t%d\t%s\t%d\t%s", f, fm ? sprintf("%.1f", f * 100 / fm) : "-", \
+				s, sm ? sprintf("%.1f", s * 100 / sm) : "-"
+		}' "$map"
+
+	if [ -x "$BENCH" ] && $BENCH -m "$mcu" -t "$SCRIPT" "$elf" > "$dir/bench.tsv" 2>/dev/null
+	then
+		awk -F '\t' -v n=$ncmds '
+			$1 == "cmd" { printf "\t%s", $4; i++ }
+			END { for(; i < n; i++) printf "\t-" }' "$dir/bench.tsv"
+	else
+		i=0
+		while [ $i -lt $ncmds ]; do printf '\t-'; i=$((i + 1)); done
+	fi
+	printf '\n'
+done
@@ -0,0 +1,39 @@
+#include "config.h"
+#include "trace.h"
+
+#ifdef _trace
+
+#include "uart.h"
+
+trace_t trace_ring[TRACE_SIZE];
+uint8_t trace_head;
+uint8_t trace_count;
+uint8_t trace_on = 1;
+
+/* Stream the ring oldest first: count, then type, arg, ts low, ts high
+ * for each event. Tracing pauses so the dump does not trace itself.
+ */
+void trace_dump(void)
+{
+    uint8_t i, n, x;
+
+    trace_on = 0;
+    n = trace_count;
+    x = (trace_head - n) & (TRACE_SIZE - 1);
+
+    io_write(0x100 | n);
+    for(i = 0; i < n; i++)
+    {
+        trace_t *e = &trace_ring[x];
+        io_write(e->type);
+        io_write(e->arg);
+        io_write(e->ts & 0xFF);
+        io_write(e->ts >> 8);
+        x = (x + 1) & (TRACE_SIZE - 1);
+    }
+
+    trace_count = 0;
+    trace_on = 1;
+}
+
+#endif // _trace
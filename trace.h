@@ -0,0 +1,68 @@
+#ifndef _TRACE_H_
+#define _TRACE_H_
+
+#include "config.h"
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+/* Event types, bit 0 of RX/TX carries the 9th bit of the frame */
+#define TRACE_RX        0x02    /* arg = frame */
+#define TRACE_TX        0x04    /* arg = frame */
+#define TRACE_RX_ERROR  0x06    /* arg = frame, bad start or stop bit */
+#define TRACE_CMD       0x10    /* arg = command class */
+#define TRACE_CMD_END   0x11    /* arg = command class */
+#define TRACE_CRYPT     0x20    /* arg = cryptmode */
+#define TRACE_CRYPT_END 0x21    /* arg = check */
+#define TRACE_BUSY      0x30
+#define TRACE_EEPROM    0x40    /* arg = EEPROM address, low byte */
+#define TRACE_ABORT     0x50    /* arg = scheduler task */
+
+typedef struct
+{
+    uint8_t type;
+    uint8_t arg;
+    uint16_t ts;                /* F_CPU/8 ticks */
+} trace_t;
+
+#ifdef _trace
+
+#include "tick.h"
+
+#if TRACE_SIZE & (TRACE_SIZE - 1)
+#error "TRACE_SIZE has to be a power of 2"
+#endif
+
+extern trace_t trace_ring[TRACE_SIZE];
+extern uint8_t trace_head;
+extern uint8_t trace_count;
+extern uint8_t trace_on;
+
+static inline void
+trace(const uint8_t type, const uint8_t arg)
+{
+    uint8_t sreg = SREG;
+    cli();
+    if (trace_on)
+    {
+        trace_t *e = &trace_ring[trace_head];
+        e->type = type;
+        e->arg = arg;
+        e->ts = tick_now();
+        trace_head = (trace_head + 1) & (TRACE_SIZE - 1);
+        if (trace_count < TRACE_SIZE)
+            trace_count++;
+    }
+    SREG = sreg;
+}
+
+#define TRACE(t, a) trace((t), (a))
+
+extern void trace_dump(void);
+
+#else // _trace
+
+#define TRACE(t, a) do {} while(0)
+
+#endif // _trace
+
+#endif /* _TRACE_H_ */
@@ -1,13 +1,17 @@
 #include "config.h"
 #include "uart.h"
+#include "perf.h"
+#include "trace.h"
+#include "tick.h"
+#include "sched.h"
 
 /* comment out if you don't need a fifo */
 #include "fifo.h"
 
 #include <avr/io.h>
 #include <avr/interrupt.h>
-#include <util/delay.h>
-#define delay 1000    /* usec between TX => RX */
+#include <util/delay_basic.h>
+#define GUARD_ETU 12  /* bit times from one TX start to the next */
 
 
 /* TXD */
@@ -26,6 +30,27 @@
 static volatile uint16_t outframe;
 static volatile uint16_t inframe;
 static volatile uint16_t inbits, received;
+static tick_timer_t guard;
+static tick_t guard_ticks;
+static uint8_t bad_frames;
+
+#ifdef _rxvote
+/* Three samples 1/8 ETU apart, the middle one on the half bit. vote_lead
+ * is the one gap from the first to the middle sample (vote_loops delay
+ * loops of 3 cycles plus ~4 for the pin read and branch), vote_entry the
+ * time from the compare match to the first sample (interrupt response
+ * and the COMPB prologue). vote_entry depends on the compiler, so the handler
+ * measures it and keeps the smallest value seen.
+ */
+#define VOTE_ENTRY_GUESS 64     /* cycles, upper bound until measured */
+static uint8_t vote_loops;
+static uint8_t vote_lead;
+static volatile uint8_t vote_entry;
+#endif // _rxvote
+
+#ifdef _rxerrsig
+#define RX_ERRSIG 0xFF  /* inbits while the error signal is on the line */
+#endif // _rxerrsig
 
 
 #ifdef _FIFO_H_
@@ -36,6 +61,20 @@ static volatile uint16_t inbits, received;
     static volatile uint16_t indata;
 #endif // _FIFO_H_
 
+/* Everything derived from the bit time, line has to be idle */
+static void etu_apply(uint16_t etu)
+{
+    OCR1A = etu;
+    TCNT1 = 0;
+    guard_ticks = (tick_t) (((uint32_t) etu * GUARD_ETU) / TICK_PRESCALE);
+#ifdef _rxvote
+    vote_loops = etu / (8 * 3);
+    vote_lead = vote_loops * 3 + 4;
+    vote_entry = VOTE_ENTRY_GUESS;
+#endif // _rxvote
+    bad_frames = 0;
+}
+
 void io_init()
 {
     uint8_t tifr = 0;
@@ -49,7 +88,7 @@ void io_init()
     TCCR1B = (1 << CTC1) | (1 << CS10) | (0 << ICES1) | (1 << ICNC1);
 
     // OutputCompare fr gewnschte Timer1 Frequenz
-    OCR1A = (uint16_t) ((uint32_t) F_CPU/BAUDRATE);
+    etu_apply(IO_ETU_DEFAULT);
     tifr  |= (1 << ICF1) | (1 << OCF1B) | (1 << OCF1A);
     outframe = 0;
     TIFR = tifr;
@@ -60,6 +99,20 @@ void io_init()
 #endif // _FIFO_H_
 }
 
+/* Switch the bit time between two frames: after the last frame sent
+ * and its guard time, before the decoder starts the next one (PPS).
+ */
+void io_set_etu(uint16_t etu)
+{
+    do
+    {
+        sei(); nop(); cli();
+    } while (outframe || !tick_expired(&guard));
+
+    etu_apply(etu);
+    sei();
+}
+
 void enable_tx(void){
     cli();
     /* DISABLE ICP INTERRUPT */
@@ -71,12 +124,20 @@ void enable_tx(void){
 }
 
 void enable_rx(void){
-    cli();
+    /* LET THE LAST CHAR LEAVE BEFORE RELEASING THE LINE */
+    do
+    {
+        sei(); nop(); cli();
+    } while (outframe);
+
+    /* CAPTURES WHILE SENDING WERE OUR OWN EDGES */
+    if (SUART_RXD_DDR & (1 << SUART_RXD_BIT))
+        TIFR = (1 << ICF1);
     /* SET PIN TO INPUT */
     SUART_RXD_DDR  &= ~(1 << SUART_RXD_BIT);
     SUART_RXD_PORT &= ~(1 << SUART_RXD_BIT);
     /* ENABLE ICP INTERRUPT */
-    TIMSK |= (1 << TICIE1) | (1 << TOIE0);
+    TIMSK |= (1 << TICIE1);
     sei();
 }
 
@@ -85,21 +146,21 @@ void io_write(const uint16_t c)
 {
     enable_tx();
 
-    /* WAIT FOR LAST CHAR SENT */
+    /* WAIT FOR LAST CHAR SENT AND GUARD TIME */
     do
     {
         sei(); nop(); cli(); // yield();
-    } while (outframe);
+    } while (outframe || !tick_expired(&guard));
 
     // frame = *.P.7.6.5.4.3.2.1.0.S   S=Start(0), P=Stop(1), *=Endemarke(1)
     outframe = (3 << (9+_9N1)) | (((uint16_t) c) << 1);
+    TRACE(TRACE_TX | ((c >> 8) & 1), c);
 
     TIMSK |= (1 << OCIE1A);
     TIFR   = (1 << OCF1A);
-
+    tick_start(&guard, guard_ticks);
 
     sei();
-    _delay_us(delay);
     //enable_rx();
 }
 
@@ -131,6 +192,13 @@ ISR (TIMER1_CAPT_vect)
 
     // Eine halbe Bitzeit zu ICR1 addieren (modulo OCR1A) und nach OCR1B
     uint16_t ocr1b = icr1 + ocr1a/2;
+#ifdef _rxvote
+    uint8_t lead = vote_lead + vote_entry;
+
+    if (ocr1b < lead)
+        ocr1b += ocr1a;
+    ocr1b -= lead;
+#endif // _rxvote
     if (ocr1b >= ocr1a)
         ocr1b -= ocr1a;
     OCR1B = ocr1b;
@@ -141,31 +209,88 @@ ISR (TIMER1_CAPT_vect)
     inbits = 0;
 }
 
+#ifdef _rxvote
+static inline uint8_t rx_vote(void)
+{
+    uint8_t n = 0;
+    uint16_t late;
+
+    if (SUART_RXD_PIN & (1 << SUART_RXD_BIT)) n++;
+    /* cycles since the match, read a few cycles after the sample */
+    late = TCNT1 - OCR1B;
+    if (late > OCR1A)
+        late += OCR1A;
+    if (late < vote_entry)
+        vote_entry = late;
+    _delay_loop_1(vote_loops);
+    if (SUART_RXD_PIN & (1 << SUART_RXD_BIT)) n++;
+    _delay_loop_1(vote_loops);
+    if (SUART_RXD_PIN & (1 << SUART_RXD_BIT)) n++;
+
+    if (n == 1 || n == 2)
+        PERF_INC(rx_votes);
+    return n & 2;
+}
+#endif // _rxvote
+
 /* FETCH INPUT BITS */
 //SIGNAL (SIG_OUTPUT_COMPARE1B)
 ISR (TIMER1_COMPB_vect)
 {
+#ifdef _rxerrsig
+    if (RX_ERRSIG == inbits)
+    {
+        /* ONE ETU IS OVER, RELEASE THE LINE AND WAIT FOR THE REPEAT */
+        SUART_RXD_DDR &= ~(1 << SUART_RXD_BIT);
+        TIMSK = (TIMSK & ~(1 << OCIE1B)) | (1 << TICIE1);
+        TIFR = (1 << ICF1);
+        inbits = 0;
+        return;
+    }
+#endif // _rxerrsig
 
     uint16_t data = inframe >> 1;
 
+#ifdef _rxvote
+    if (rx_vote())
+#else
     if (SUART_RXD_PIN & (1 << SUART_RXD_BIT))
+#endif // _rxvote
         data |= (1 << (9+_9N1));
 
     uint16_t bits = inbits+1;
 
     if (10+_9N1 == bits)
     {
-        if ((data & 1) == 0)
-            if (data >= (1 << (9+_9N1)))
-            {
+        if ((data & 1) == 0 && data >= (1 << (9+_9N1)))
+        {
 
 #ifdef _FIFO_H_
-                _inline_fifo_put (&infifo, data >> 1);
+            if (!_inline_fifo_put (&infifo, data >> 1))
+                PERF_INC(fifo_overflow);
 #else
-                indata = data >> 1;
+            indata = data >> 1;
 #endif // _FIFO_H_
             received = 1;
-            }
+            bad_frames = 0;
+            TRACE(TRACE_RX | ((data >> 9) & 1), data >> 1);
+        }
+        else
+        {
+            PERF_INC(frame_errors);
+            TRACE(TRACE_RX_ERROR | ((data >> 9) & 1), data >> 1);
+            /* DECODER LOST THE NEGOTIATED SPEED (RESET?), GO BACK */
+            if (OCR1A != IO_ETU_DEFAULT && ++bad_frames >= PPS_FALLBACK)
+                etu_apply(IO_ETU_DEFAULT);
+#ifdef _rxerrsig
+            /* ISO 7816-3 ERROR SIGNAL: PULL THE LINE LOW FROM THE MIDDLE
+             * OF THE STOP BIT, THE SENDER REPEATS THE FRAME */
+            SUART_RXD_DDR |= (1 << SUART_RXD_BIT);
+            inbits = RX_ERRSIG;
+            PERF_INC(rx_errsig);
+            return;
+#endif // _rxerrsig
+        }
         TIMSK = (TIMSK & ~(1 << OCIE1B)) | (1 << TICIE1);
         TIFR = (1 << ICF1);
     }
@@ -178,11 +303,12 @@ ISR (TIMER1_COMPB_vect)
 #ifdef _syster
 #ifdef _FIFO_H_
     if(infifo.count == 2){
-        uart_getc_nowait();
-        uart_getc_nowait();
+        uint16_t a = uart_getc_nowait();
+        uint16_t b = uart_getc_nowait();
         infifo.count = 0;
-        io_write(0x101);
-        _delay_us(delay);
+        PERF_INC(busy);
+        TRACE(TRACE_BUSY, 0);
+        io_write(io_busy_answer(a, b));
         enable_rx();
 
     }
@@ -196,6 +322,24 @@ ISR (TIMER1_COMPB_vect)
 uint16_t io_read()
 {
     enable_rx();
+    sched_begin(SCHED_IO, TICKS_US(SCHED_IO_US));
+    while (!infifo.count)
+        sched_yield();
+    sched_end();
+
+    return (uint16_t) _9N1 ? fifo_get_wait(&infifo) & 0x1FF : fifo_get_wait(&infifo) & 0xFF;
+}
+
+uint16_t io_read_timeout(tick_t timeout)
+{
+    tick_timer_t t;
+
+    enable_rx();
+    tick_start(&t, timeout);
+    while (!infifo.count)
+        if (tick_expired(&t))
+            return IO_TIMEOUT;
+
     return (uint16_t) _9N1 ? fifo_get_wait(&infifo) & 0x1FF : fifo_get_wait(&infifo) & 0xFF;
 }
 
@@ -205,12 +349,36 @@ uint16_t uart_getc_nowait()
     return fifo_get_nowait (&infifo);
 }
 
+/* Drop whatever an aborted command left behind */
+void io_flush(void)
+{
+    while (infifo.count)
+        fifo_get_nowait(&infifo);
+}
+
 #else // _FIFO_H_
 
 uint16_t io_read()
 {
     enable_rx();
-    while (!received)   {}
+    sched_begin(SCHED_IO, TICKS_US(SCHED_IO_US));
+    while (!received)
+        sched_yield();
+    sched_end();
+    received = 0;
+
+    return (uint16_t) _9N1 ? indata & 0x1FF : indata & 0xFF;
+}
+
+uint16_t io_read_timeout(tick_t timeout)
+{
+    tick_timer_t t;
+
+    enable_rx();
+    tick_start(&t, timeout);
+    while (!received)
+        if (tick_expired(&t))
+            return IO_TIMEOUT;
     received = 0;
 
     return (uint16_t) _9N1 ? indata & 0x1FF : indata & 0xFF;
@@ -233,4 +401,9 @@ uint16_t uart_getc_nowait()
 
 }
 
+void io_flush(void)
+{
+    received = 0;
+}
+
 #endif // _FIFO_H_
@@ -2,14 +2,28 @@
 #define _UART_H_
 #define nop() __asm volatile ("nop")
 #include <avr/io.h>
+#include "tick.h"
+
+#define IO_TIMEOUT 0xFFFF
+
+/* Bit time in CPU cycles at BAUDRATE, PPS divides it by 1 << (DI - 1) */
+#define IO_ETU_DEFAULT ((uint16_t) ((uint32_t) (F_CPU) / BAUDRATE))
+#define PPS_TA1 (0x10 | PPS_DI_MAX)   /* FI 1 (372), fastest DI */
+#define PPS_FALLBACK 4                /* bad frames in a row, back to default */
 
 
 extern void io_init();
+extern void io_set_etu(uint16_t etu);
 
 extern void io_write(const uint16_t);
 
 extern uint16_t io_read();
+extern uint16_t io_read_timeout(tick_t timeout);
 extern uint16_t uart_getc_nowait();
+extern void io_flush(void);
+
+/* Answer to a pair received while the main loop is busy, see main.c */
+extern uint16_t io_busy_answer(uint16_t a, uint16_t b);
 
 extern void enable_tx(void);
 extern void enable_rx();